@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_U2K_XFER_H
+#define _UAPI_LINUX_U2K_XFER_H
+
+/*
+ * sys_u2k_xfer(451)：一次进入内核执行一组分散/聚集传输。
+ * 本文件与 00-qemu/patches 中内核补丁的 include/uapi/linux/u2k_xfer.h 相同，用户态程序直接包含。
+ *
+ *   long syscall(SYS_u2k_xfer, struct u2k_xfer_desc *descs, unsigned int nr, unsigned int flags);
+ *
+ * 描述符按顺序执行，每个描述符相当于一次 pread(fd, buf, len, off) 或 pwrite(fd, buf, len, off)，
+ * 结果（传输的字节数或 -errno）写回 result。默认在第一个出错或传输不足 len 的描述符之后停止，
+ * 带 U2K_XFER_F_CONTINUE 时总是执行全部描述符。
+ * 返回值为已执行（result 已写回）的描述符个数；一个都未执行时返回 -1 并设置 errno。
+ */
+#include <linux/types.h>
+
+#ifndef __NR_u2k_xfer
+#define __NR_u2k_xfer 451  // 与 syscall_64.tbl 一致
+#endif
+
+#define U2K_XFER_READ  0  // fd 的 [off, off + len) -> buf
+#define U2K_XFER_WRITE 1  // buf -> fd 的 [off, off + len)
+
+#define U2K_XFER_F_CONTINUE 0x1  // 出错或传输不足时继续执行后面的描述符
+
+#define U2K_XFER_MAX 1024  // 单次调用的最大描述符个数
+
+struct u2k_xfer_desc {
+    __u32 dir;     // U2K_XFER_READ / U2K_XFER_WRITE
+    __s32 fd;      // 内核对象：支持 pread/pwrite 的文件描述符
+    __u64 buf;     // 用户缓冲区地址
+    __u64 off;     // 对象内的偏移
+    __u64 len;     // 字节数
+    __s64 result;  // 输出：传输的字节数或 -errno，未执行的描述符保持不变
+};
+
+#endif /* _UAPI_LINUX_U2K_XFER_H */
@@ -0,0 +1,103 @@
+#ifndef MY_IOCTL_H
+#define MY_IOCTL_H
+
+/*
+ * my_ioctl_dev 内核模块与用户态程序共享的 IOCTL 定义。
+ */
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+// IOCTL 命令定义
+#define IOCTL_GET_VALUE _IOR('a', 1, int *) // 读取设备中的值
+#define IOCTL_SET_VALUE _IOW('a', 2, int *) // 设置设备中的值
+#define IOCTL_BATCH     _IOWR('a', 3, struct my_ioctl_batch) // 一次执行多条命令
+
+/*
+ * 原子槽位：设备持有 MY_IOCTL_NR_SLOTS 个 64 位槽位，所有操作都用内核原子指令完成，
+ * 多个进程可以通过设备协调而不需要跨系统调用持锁。IOCTL_GET_VALUE/SET_VALUE 读写 0 号槽位。
+ */
+#define MY_IOCTL_NR_SLOTS 64
+
+#define IOCTL_SLOT_GET       _IOWR('a', 4, struct my_ioctl_slot_op) // result = slot
+#define IOCTL_SLOT_SET       _IOW('a', 5, struct my_ioctl_slot_op)  // slot = arg
+#define IOCTL_SLOT_FETCH_ADD _IOWR('a', 6, struct my_ioctl_slot_op) // result = slot, slot += arg
+#define IOCTL_SLOT_CAS       _IOWR('a', 7, struct my_ioctl_slot_op) // result = slot, slot == arg 时 slot = arg2
+#define IOCTL_SLOT_XCHG      _IOWR('a', 8, struct my_ioctl_slot_op) // result = slot, slot = arg
+
+// 单条槽位操作的参数
+struct my_ioctl_slot_op {
+    __u32 slot;    // 槽位下标
+    __u32 reserved;
+    __u64 arg;     // 操作数；CAS 时为期望值
+    __u64 arg2;    // CAS 时为新值
+    __u64 result;  // 输出：操作前的值
+};
+
+// 批量命令中的一条
+struct my_ioctl_batch_entry {
+    __u32 cmd;     // 命令，如 IOCTL_GET_VALUE / IOCTL_SLOT_FETCH_ADD
+    __s32 status;  // 输出：0 表示成功，负数为错误码
+    __u32 slot;    // 槽位命令使用的槽位下标
+    __u32 reserved;
+    __u64 arg;     // 输入参数
+    __u64 arg2;    // 第二个输入参数（CAS 的新值）
+    __u64 result;  // 输出结果，如 GET 读到的值
+};
+
+// IOCTL_BATCH 的参数
+struct my_ioctl_batch {
+    __u64 entries; // 用户空间 struct my_ioctl_batch_entry 数组的地址
+    __u32 count;   // 条目数
+    __u32 done;    // 输出：内核已处理的条目数
+};
+
+/*
+ * 统计信息：驱动用 per-CPU 计数器累加，IOCTL_GET_STATS 在读取时汇总所有 CPU。
+ */
+#define IOCTL_GET_STATS _IOR('a', 9, struct my_ioctl_stats)
+
+struct my_ioctl_stats {
+    __u64 get;           // GET 类命令次数（IOCTL_GET_VALUE / IOCTL_SLOT_GET）
+    __u64 set;           // SET 类命令次数（IOCTL_SET_VALUE / IOCTL_SLOT_SET）
+    __u64 atomic;        // FETCH_ADD / CAS / XCHG 次数
+    __u64 batch;         // IOCTL_BATCH 调用次数
+    __u64 batch_entries; // 批量执行的条目总数
+    __u64 bytes;         // 与用户空间之间拷贝的字节数
+};
+
+/*
+ * 只读共享页（mmap 偏移 0 处的一页）：内核把 0 ~ MY_IOCTL_NR_SHARED-1 号槽位与统计计数器发布在这里，
+ * 用户态读取不需要系统调用，适合频繁读取、很少变化的配置值或计数器。
+ * IOCTL_SHARED_PUBLISH 以及每 publish_ms 毫秒（加载参数，0 表示关闭）发布全部槽位与统计的快照，
+ * 共享页只在这时更新：槽位命令保持无锁，不写共享页，因此 SET 之后需要 IOCTL_SHARED_PUBLISH
+ * 或等到下一次定时发布才能在共享页中看到新值。
+ * 写者：seq 加一（变为奇数）-> 写数据 -> seq 加一（变为偶数），写者之间由内核中的锁串行化。
+ * 读者：读 seq（奇数时等待）-> 读数据 -> 再读 seq，不相等则重试。用户态的读取方法见 my_ioctl_shared.h。
+ */
+#define MY_IOCTL_NR_SHARED 8
+
+#define IOCTL_SHARED_PUBLISH _IO('a', 10) // 立即发布一次快照
+
+struct my_ioctl_shared {
+    __u32 seq;                         // 序号，奇数表示正在更新
+    __u32 nr_values;                   // values[] 的有效个数，等于 MY_IOCTL_NR_SHARED
+    __u64 updates;                     // 发布次数
+    __u64 publish_ns;                  // 最近一次发布时的 CLOCK_MONOTONIC 纳秒
+    __u64 values[MY_IOCTL_NR_SHARED];  // 槽位的值，values[0] 即 IOCTL_GET_VALUE 读到的值
+    struct my_ioctl_stats stats;       // 统计计数器快照
+};
+
+/*
+ * io_uring 直通（IORING_OP_URING_CMD）：sqe->cmd_op 填上面的 IOCTL 命令号，
+ * 参数放在 SQE 的 cmd 区域，因此 ring 需要以 IORING_SETUP_SQE128 | IORING_SETUP_CQE32 创建。
+ * 完成时 cqe->res 为 0 或负的错误码，命令的结果（如 GET 读到的值、FETCH_ADD 的旧值）
+ * 放在 cqe->big_cqe[0]。IOCTL_BATCH / IOCTL_GET_STATS 的 arg 是用户空间结构体的地址。
+ */
+struct my_ioctl_uring_cmd {
+    __u32 slot;    // 槽位下标
+    __u32 reserved;
+    __u64 arg;     // 操作数；IOCTL_SET_VALUE 的值；IOCTL_BATCH / IOCTL_GET_STATS 的用户地址
+    __u64 arg2;    // CAS 时为新值
+};
+
+#endif // MY_IOCTL_H
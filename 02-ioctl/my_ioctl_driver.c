@@ -5,34 +5,346 @@
 #include <linux/device.h>   // 设备创建
 #include <linux/uaccess.h>  // 处理用户空间数据
 #include <linux/version.h>  // 确保 LINUX_VERSION_CODE 可用
+#include <linux/sched.h>    // cond_resched
+#include <linux/atomic.h>   // atomic64_*
+#include <linux/nospec.h>   // array_index_nospec
+#include <linux/mm.h>       // remap_pfn_range
+#include <linux/spinlock.h>
+#include <linux/workqueue.h> // 定时发布共享页
+#include <linux/ktime.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,7,0)
+#include <linux/io_uring/cmd.h> // struct io_uring_cmd
+#else
+#include <linux/io_uring.h>
+#endif
+
+#include "my_ioctl.h"       // IOCTL 命令与批量命令结构
+#include "u2k_stats.h"      // per-CPU 统计计数器
+#include "u2k_lat.h"        // 延迟直方图（u2k_common.ko）
+#include "u2k_trace.h"      // 跟踪点（u2k_common.ko）
 
 // 设备名称和类名
 #define DEVICE_NAME "my_ioctl_dev"
 #define CLASS_NAME "my_ioctl_class"
 
-// IOCTL 命令定义
-#define IOCTL_GET_VALUE _IOR('a', 1, int *) // 读取设备中的值
-#define IOCTL_SET_VALUE _IOW('a', 2, int *) // 设置设备中的值
+// 批量命令每次从用户空间拷贝的条目数，放在栈上
+#define BATCH_CHUNK 16
 
 static dev_t dev_num;           // 设备号
 static struct cdev my_cdev;     // 字符设备结构
 static struct class *my_class;  // 设备类
 static struct device *my_device; // 设备指针
 
+// 原子槽位，每个槽位独占一个 cache line，避免不同槽位之间的伪共享
+static struct {
+    atomic64_t value;
+} ____cacheline_aligned_in_smp slots[MY_IOCTL_NR_SLOTS];
+
+// 统计计数器下标，顺序与 struct my_ioctl_stats 的字段一致
+enum {
+    MY_STAT_GET,
+    MY_STAT_SET,
+    MY_STAT_ATOMIC,
+    MY_STAT_BATCH,
+    MY_STAT_BATCH_ENTRIES,
+    MY_STAT_BYTES,
+    MY_STAT_NR,
+};
+
+/*
+ * 统计方式：0 关闭，1 per-CPU 计数器（默认），2 共享原子计数器。
+ * 2 只用于和 per-CPU 方式做对比，展示多核下共享计数器本身成为瓶颈。
+ */
+static int stats_mode = 1;
+module_param(stats_mode, int, 0644);
+MODULE_PARM_DESC(stats_mode, "0 = no stats, 1 = per-CPU counters, 2 = shared atomic counters");
+
+static DEFINE_PER_CPU(struct u2k_stats, my_stats);
+static atomic64_t my_shared_stats[MY_STAT_NR];
+
+// 延迟直方图 /proc/u2k/ioctl，每类命令一行
+enum {
+    MY_LAT_GET,
+    MY_LAT_SET,
+    MY_LAT_ATOMIC,
+    MY_LAT_BATCH,
+    MY_LAT_STATS,
+    MY_LAT_URING,   // 经 io_uring 直通提交的命令
+    MY_LAT_NR,
+};
+static const char *const my_lat_names[MY_LAT_NR] = {
+    "get", "set", "atomic", "batch", "stats", "uring",
+};
+static struct u2k_lat *my_lat;
+
+static int my_lat_op(unsigned int cmd) {
+    switch (cmd) {
+        case IOCTL_GET_VALUE:
+        case IOCTL_SLOT_GET:
+            return MY_LAT_GET;
+        case IOCTL_SET_VALUE:
+        case IOCTL_SLOT_SET:
+            return MY_LAT_SET;
+        case IOCTL_BATCH:
+            return MY_LAT_BATCH;
+        case IOCTL_GET_STATS:
+        case IOCTL_SHARED_PUBLISH:
+            return MY_LAT_STATS;
+        default:
+            return MY_LAT_ATOMIC;  // 无效命令也计入这一行，它们同样走完了一次陷入
+    }
+}
+
+static inline void my_stat_add(int idx, u64 n) {
+    switch (READ_ONCE(stats_mode)) {
+        case 1:
+            u2k_stats_add(my_stats, idx, n);
+            break;
+        case 2:
+            atomic64_add(n, &my_shared_stats[idx]);
+            break;
+    }
+}
+
+// 汇总所有 CPU 上的计数器，顺序与 struct my_ioctl_stats 的字段一致
+static void my_stats_sum(u64 *sum) {
+    int i;
+
+    u2k_stats_sum(&my_stats, sum, MY_STAT_NR);
+    for (i = 0; i < MY_STAT_NR; i++) {
+        sum[i] += atomic64_read(&my_shared_stats[i]);
+    }
+}
+
+/*
+ * 只读共享页，布局见 my_ioctl.h 中的 struct my_ioctl_shared。
+ * 写者之间由 my_shared_lock 串行化；读者在用户态，不持锁，靠 seq 发现并发的更新后重试。
+ * 所有写者都在进程上下文（IOCTL_SHARED_PUBLISH 的 ioctl 与 io_uring 提交路径、工作队列），用普通的 spin_lock 即可。
+ */
+static struct my_ioctl_shared *my_shared;
+static DEFINE_SPINLOCK(my_shared_lock);
+
+// 定时发布的周期（毫秒），0 表示只在 IOCTL_SHARED_PUBLISH 时发布全部快照
+static unsigned int publish_ms = 100;
+module_param(publish_ms, uint, 0444);
+MODULE_PARM_DESC(publish_ms, "Period in ms for publishing slots and stats to the shared page (0 = only on IOCTL_SHARED_PUBLISH)");
+
+static void my_publish_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(my_publish_work, my_publish_fn);
+
+// seq 变为奇数之后才能写数据，smp_wmb 保证读者先看到奇数的 seq
+static void my_shared_write_begin(void) {
+    spin_lock(&my_shared_lock);
+    WRITE_ONCE(my_shared->seq, my_shared->seq + 1);
+    smp_wmb();
+}
+
+// 数据写完之后 seq 才变回偶数
+static void my_shared_write_end(void) {
+    WRITE_ONCE(my_shared->updates, my_shared->updates + 1);
+    WRITE_ONCE(my_shared->publish_ns, ktime_get_ns());
+    smp_wmb();
+    WRITE_ONCE(my_shared->seq, my_shared->seq + 1);
+    spin_unlock(&my_shared_lock);
+}
+
+/*
+ * 发布全部槽位与统计计数器的快照。只由定时工作和 IOCTL_SHARED_PUBLISH 调用，
+ * 槽位命令本身不碰共享页，保持无锁，不会在多线程 SET 时争用 my_shared_lock 和共享页的 cache line。
+ */
+static void my_shared_publish(void) {
+    u64 sum[MY_STAT_NR];
+    int i;
+
+    my_stats_sum(sum);  // 在锁外汇总，缩短读者需要重试的窗口
+    my_shared_write_begin();
+    for (i = 0; i < MY_IOCTL_NR_SHARED; i++) {
+        WRITE_ONCE(my_shared->values[i], atomic64_read(&slots[i].value));
+    }
+    memcpy(&my_shared->stats, sum, sizeof(sum));
+    my_shared_write_end();
+}
+
+static void my_publish_fn(struct work_struct *work) {
+    my_shared_publish();
+    schedule_delayed_work(&my_publish_work, msecs_to_jiffies(publish_ms));
+}
+
 /**
- * @brief 处理 IOCTL 命令
+ * @brief 执行一条命令，单条 IOCTL 与批量 IOCTL 共用
+ *
+ * @param cmd 命令
+ * @param slot 槽位下标（槽位命令使用）
+ * @param arg 输入参数
+ * @param arg2 第二个输入参数（CAS 的新值）
+ * @param result 输出结果
+ * @return long 返回 0 表示成功，负数表示错误
+ */
+static long my_ioctl_exec(unsigned int cmd, u32 slot, u64 arg, u64 arg2, u64 *result) {
+    atomic64_t *v;
+
+    switch (cmd) {
+        case IOCTL_GET_VALUE:
+            my_stat_add(MY_STAT_GET, 1);
+            *result = atomic64_read(&slots[0].value);
+            return 0;
+
+        case IOCTL_SET_VALUE:
+            my_stat_add(MY_STAT_SET, 1);
+            atomic64_set(&slots[0].value, (int)arg);
+            *result = 0;
+            return 0;
+
+        case IOCTL_SLOT_GET:
+        case IOCTL_SLOT_SET:
+        case IOCTL_SLOT_FETCH_ADD:
+        case IOCTL_SLOT_CAS:
+        case IOCTL_SLOT_XCHG:
+            if (slot >= MY_IOCTL_NR_SLOTS) {
+                return -EINVAL;
+            }
+            v = &slots[array_index_nospec(slot, MY_IOCTL_NR_SLOTS)].value;
+            break;
+
+        default:
+            return -EINVAL; // 无效命令（包括嵌套的 IOCTL_BATCH）
+    }
+
+    switch (cmd) {
+        case IOCTL_SLOT_GET:
+            my_stat_add(MY_STAT_GET, 1);
+            *result = atomic64_read(v);
+            break;
+        case IOCTL_SLOT_SET:
+            my_stat_add(MY_STAT_SET, 1);
+            atomic64_set(v, arg);
+            *result = 0;
+            break;
+        case IOCTL_SLOT_FETCH_ADD:
+            my_stat_add(MY_STAT_ATOMIC, 1);
+            *result = atomic64_fetch_add(arg, v);
+            break;
+        case IOCTL_SLOT_CAS:
+            my_stat_add(MY_STAT_ATOMIC, 1);
+            *result = atomic64_cmpxchg(v, arg, arg2); // 返回旧值，等于 arg 即成功
+            break;
+        case IOCTL_SLOT_XCHG:
+            my_stat_add(MY_STAT_ATOMIC, 1);
+            *result = atomic64_xchg(v, arg);
+            break;
+    }
+    return 0;
+}
+
+/**
+ * @brief 执行单条槽位命令：拷入参数、执行、把旧值写回
+ *
+ * @param cmd 槽位命令
+ * @param arg 用户空间 struct my_ioctl_slot_op 的地址
+ * @return long 返回 0 表示成功，负数表示错误
+ */
+static long my_ioctl_slot(unsigned int cmd, unsigned long arg) {
+    struct my_ioctl_slot_op __user *uop = (struct my_ioctl_slot_op __user *)arg;
+    struct my_ioctl_slot_op op;
+    long ret;
+
+    if (copy_from_user(&op, uop, sizeof(op))) {
+        return -EFAULT;
+    }
+    ret = my_ioctl_exec(cmd, op.slot, op.arg, op.arg2, &op.result);
+    if (ret) {
+        return ret;
+    }
+    if (cmd != IOCTL_SLOT_SET && put_user(op.result, &uop->result)) {
+        return -EFAULT;
+    }
+    my_stat_add(MY_STAT_BYTES, sizeof(op) + (cmd != IOCTL_SLOT_SET ? sizeof(op.result) : 0));
+    return 0;
+}
+
+/**
+ * @brief 批量执行命令：一次陷入内核处理整个条目数组
+ *
+ * 条目分块拷贝到栈上执行，再把每条的 status/result 写回。每条命令的错误只记录在
+ * 自己的 status 中，不会中断整个批次；只有访问用户内存失败时才提前返回，
+ * 此时 done 给出已经完成的条目数。
+ *
+ * @param arg 用户空间 struct my_ioctl_batch 的地址
+ * @return long 返回 0 表示成功，负数表示错误
+ */
+static long my_ioctl_batch(unsigned long arg) {
+    struct my_ioctl_batch __user *ubatch = (struct my_ioctl_batch __user *)arg;
+    struct my_ioctl_batch_entry chunk[BATCH_CHUNK];
+    struct my_ioctl_batch_entry __user *uentries;
+    struct my_ioctl_batch batch;
+    u32 i, n;
+    long ret = 0;
+
+    if (copy_from_user(&batch, ubatch, sizeof(batch))) {
+        return -EFAULT;
+    }
+    uentries = u64_to_user_ptr(batch.entries);
+
+    for (batch.done = 0; batch.done < batch.count; batch.done += n) {
+        n = min_t(u32, batch.count - batch.done, BATCH_CHUNK);
+        if (copy_from_user(chunk, uentries + batch.done, n * sizeof(chunk[0]))) {
+            ret = -EFAULT;
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            chunk[i].status = my_ioctl_exec(chunk[i].cmd, chunk[i].slot, chunk[i].arg,
+                                            chunk[i].arg2, &chunk[i].result);
+        }
+        if (copy_to_user(uentries + batch.done, chunk, n * sizeof(chunk[0]))) {
+            ret = -EFAULT;
+            break;
+        }
+        cond_resched(); // 很大的批次也不会长时间占用 CPU
+    }
+
+    if (put_user(batch.done, &ubatch->done)) {
+        return -EFAULT;
+    }
+    my_stat_add(MY_STAT_BATCH, 1);
+    my_stat_add(MY_STAT_BATCH_ENTRIES, batch.done);
+    my_stat_add(MY_STAT_BYTES, sizeof(batch) + 2 * batch.done * sizeof(chunk[0]));
+    return ret;
+}
+
+/**
+ * @brief 汇总所有 CPU 上的计数器并拷贝给用户
+ *
+ * @param arg 用户空间 struct my_ioctl_stats 的地址
+ * @return long 返回 0 表示成功，负数表示错误
+ */
+static long my_ioctl_get_stats(unsigned long arg) {
+    u64 sum[MY_STAT_NR];
+
+    BUILD_BUG_ON(sizeof(struct my_ioctl_stats) != sizeof(sum));
+
+    my_stats_sum(sum);
+    if (copy_to_user((struct my_ioctl_stats __user *)arg, sum, sizeof(sum))) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/**
+ * @brief 分发 IOCTL 命令
  *
- * @param file 指向打开的设备文件
  * @param cmd IOCTL 命令
  * @param arg 用户空间传递的参数
  * @return long 返回 0 表示成功，负数表示错误
  */
-static long my_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
-    int value = 1234; // 设备中的内部值
+static long my_ioctl_dispatch(unsigned int cmd, unsigned long arg) {
+    int value;
     int user_value;
+    u64 result;
 
     switch (cmd) {
         case IOCTL_GET_VALUE:
+            my_ioctl_exec(cmd, 0, 0, 0, &result);
+            value = (int)result;
             // `copy_to_user` 用于将数据从内核空间复制到用户空间
             /*
              * copy_to_user 介绍
@@ -44,7 +356,7 @@ static long my_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
             if (copy_to_user((int __user *)arg, &value, sizeof(value))) {
         return -EFAULT; // 复制失败，返回错误
     }
-            printk(KERN_INFO "Sent value to user: %d\n", value);
+            my_stat_add(MY_STAT_BYTES, sizeof(value));
             break;
 
         case IOCTL_SET_VALUE:
@@ -52,9 +364,27 @@ static long my_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
             if (copy_from_user(&user_value, (int __user *)arg, sizeof(user_value))) {
         return -EFAULT; // 复制失败，返回错误
     }
-            printk(KERN_INFO "Received value from user: %d\n", user_value);
+            my_ioctl_exec(cmd, 0, user_value, 0, &result);
+            my_stat_add(MY_STAT_BYTES, sizeof(user_value));
             break;
 
+        case IOCTL_SLOT_GET:
+        case IOCTL_SLOT_SET:
+        case IOCTL_SLOT_FETCH_ADD:
+        case IOCTL_SLOT_CAS:
+        case IOCTL_SLOT_XCHG:
+            return my_ioctl_slot(cmd, arg);
+
+        case IOCTL_BATCH:
+            return my_ioctl_batch(arg);
+
+        case IOCTL_GET_STATS:
+            return my_ioctl_get_stats(arg);
+
+        case IOCTL_SHARED_PUBLISH:
+            my_shared_publish();
+            return 0;
+
         default:
             return -EINVAL; // 无效命令
     }
@@ -62,10 +392,139 @@ static long my_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
     return 0; // 成功返回
 }
 
+/**
+ * @brief 处理 IOCTL 命令，并把内核内的耗时记入延迟直方图，入口与出口各有一个跟踪点
+ *
+ * @param file 指向打开的设备文件
+ * @param cmd IOCTL 命令
+ * @param arg 用户空间传递的参数
+ * @return long 返回 0 表示成功，负数表示错误
+ */
+static long my_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    u64 start;
+    long ret;
+
+    trace_u2k_ioctl_enter(cmd, arg);
+    start = u2k_lat_start();
+    ret = my_ioctl_dispatch(cmd, arg);
+    u2k_lat_end(my_lat, my_lat_op(cmd), start);
+    trace_u2k_ioctl_exit(cmd, ret);
+    return ret;
+}
+
+/*
+ * io_uring 直通命令接口，5.19 起 file_operations 提供 .uring_cmd。
+ * 各版本之间的差异：
+ *   - 6.6 起 SQE 中的命令数据通过 io_uring_sqe_cmd() 取得，之前是 ioucmd->cmd；
+ *   - 6.5 起 io_uring_cmd_done 多了 issue_flags 参数；
+ *   - 6.18 起带 res2（写入 big_cqe[0]）的完成函数改名为 io_uring_cmd_done32。
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,19,0)
+#define MY_HAVE_URING_CMD
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,6,0)
+#define my_uring_cmd_payload(ioucmd) io_uring_sqe_cmd((ioucmd)->sqe)
+#else
+#define my_uring_cmd_payload(ioucmd) ((ioucmd)->cmd)
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,18,0)
+#define my_uring_cmd_done(ioucmd, ret, res2, flags) io_uring_cmd_done32(ioucmd, ret, res2, flags)
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(6,5,0)
+#define my_uring_cmd_done(ioucmd, ret, res2, flags) io_uring_cmd_done(ioucmd, ret, res2, flags)
+#else
+#define my_uring_cmd_done(ioucmd, ret, res2, flags) io_uring_cmd_done(ioucmd, ret, res2)
+#endif
+
+/**
+ * @brief 处理 IORING_OP_URING_CMD 提交的命令
+ *
+ * 命令号取自 sqe->cmd_op，参数取自 SQE 的 cmd 区域（struct my_ioctl_uring_cmd）。
+ * 所有命令都在提交路径上同步完成：槽位命令不访问用户内存，执行后立即完成；
+ * IOCTL_BATCH / IOCTL_GET_STATS 与 ioctl 路径共用实现，在提交者（或 SQPOLL 线程）
+ * 的地址空间中访问用户内存。结果通过 CQE32 的 big_cqe[0] 返回，
+ * 因此只接受以 SQE128 | CQE32 创建的 ring。
+ *
+ * @param ioucmd io_uring 命令
+ * @param issue_flags IO_URING_F_* 标志
+ * @return int 总是通过 my_uring_cmd_done 完成，返回 -EIOCBQUEUED；参数错误时直接返回错误码
+ */
+static int my_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags) {
+    const struct my_ioctl_uring_cmd *ucmd = my_uring_cmd_payload(ioucmd);
+    u32 slot = READ_ONCE(ucmd->slot);
+    u64 arg = READ_ONCE(ucmd->arg);
+    u64 arg2 = READ_ONCE(ucmd->arg2);
+    u64 result = 0, start = u2k_lat_start();
+    long ret;
+
+    if ((issue_flags & (IO_URING_F_SQE128 | IO_URING_F_CQE32)) != (IO_URING_F_SQE128 | IO_URING_F_CQE32)) {
+        return -EOPNOTSUPP;
+    }
+
+    // 与 ioctl 路径共用跟踪点，cmd 相同，arg 为 SQE 中的参数
+    trace_u2k_ioctl_enter(ioucmd->cmd_op, arg);
+    switch (ioucmd->cmd_op) {
+        case IOCTL_BATCH:
+            ret = my_ioctl_batch(arg);
+            break;
+        case IOCTL_GET_STATS:
+            ret = my_ioctl_get_stats(arg);
+            break;
+        case IOCTL_SHARED_PUBLISH:
+            my_shared_publish();
+            ret = 0;
+            break;
+        default:
+            ret = my_ioctl_exec(ioucmd->cmd_op, slot, arg, arg2, &result);
+            break;
+    }
+
+    u2k_lat_end(my_lat, MY_LAT_URING, start);
+    trace_u2k_ioctl_exit(ioucmd->cmd_op, ret);
+    my_uring_cmd_done(ioucmd, ret, result, issue_flags);
+    return -EIOCBQUEUED;
+}
+#endif
+
+/**
+ * @brief 把只读共享页映射到用户空间
+ *
+ * 只接受偏移 0、不超过一页的只读映射，并清除 VM_MAYWRITE，之后 mprotect 也不能再加上写权限。
+ *
+ * @param file 指向打开的设备文件
+ * @param vma 用户空间的映射区域
+ * @return int 返回 0 表示成功，负数表示错误
+ */
+static int my_mmap(struct file *file, struct vm_area_struct *vma) {
+    unsigned long size = vma->vm_end - vma->vm_start;
+    int ret;
+
+    trace_u2k_mmap_enter(vma->vm_pgoff, size);
+    if (vma->vm_pgoff || size > PAGE_SIZE) {
+        ret = -EINVAL;
+    } else if (vma->vm_flags & VM_WRITE) {
+        ret = -EPERM;
+    } else {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+        vm_flags_clear(vma, VM_MAYWRITE);
+#else
+        vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+        ret = remap_pfn_range(vma, vma->vm_start, virt_to_phys(my_shared) >> PAGE_SHIFT, size,
+                              vma->vm_page_prot);
+    }
+    trace_u2k_mmap_exit(vma->vm_pgoff, ret);
+    return ret;
+}
+
 // 定义文件操作结构体
 static struct file_operations fops = {
         .owner = THIS_MODULE,   // 设备归属当前模块
         .unlocked_ioctl = my_ioctl, // 处理 IOCTL 调用
+        .mmap = my_mmap,            // 映射只读共享页
+#ifdef MY_HAVE_URING_CMD
+        .uring_cmd = my_uring_cmd,  // 处理 io_uring 直通命令
+#endif
 };
 
 /**
@@ -76,9 +535,23 @@ static struct file_operations fops = {
 static int __init my_init(void) {
     int ret;
 
+    // 0 号槽位保留原来 IOCTL_GET_VALUE 返回的初始值
+    atomic64_set(&slots[0].value, 1234);
+
+    // 只读共享页，发布初始快照后才允许映射
+    my_shared = (struct my_ioctl_shared *)get_zeroed_page(GFP_KERNEL);
+    if (!my_shared) {
+        printk(KERN_ERR "Failed to allocate shared page\n");
+        return -ENOMEM;
+    }
+    BUILD_BUG_ON(sizeof(struct my_ioctl_shared) > PAGE_SIZE);
+    my_shared->nr_values = MY_IOCTL_NR_SHARED;
+    my_shared_publish();
+
     /*  分配字符设备号 (动态分配主设备号) 通讯 */
     ret = alloc_chrdev_region(&dev_num, 0, 1, DEVICE_NAME);
     if (ret < 0) {
+        free_page((unsigned long)my_shared);
         printk(KERN_ERR "Failed to allocate device number\n");
         return ret;
     }
@@ -91,6 +564,7 @@ static int __init my_init(void) {
     ret = cdev_add(&my_cdev, dev_num, 1);
     if (ret < 0) {
         unregister_chrdev_region(dev_num, 1);
+        free_page((unsigned long)my_shared);
         printk(KERN_ERR "Failed to add cdev\n");
         return ret;
     }
@@ -104,6 +578,7 @@ static int __init my_init(void) {
     if (IS_ERR(my_class)) {
         cdev_del(&my_cdev);
         unregister_chrdev_region(dev_num, 1);
+        free_page((unsigned long)my_shared);
         printk(KERN_ERR "Failed to create class\n");
         return PTR_ERR(my_class);
     }
@@ -114,10 +589,22 @@ static int __init my_init(void) {
         class_destroy(my_class);
         cdev_del(&my_cdev);
         unregister_chrdev_region(dev_num, 1);
+        free_page((unsigned long)my_shared);
         printk(KERN_ERR "Failed to create device\n");
         return PTR_ERR(my_device);
     }
 
+    // 观测失败不影响驱动本身，my_lat 为 NULL 时不记录
+    my_lat = u2k_lat_register("ioctl", my_lat_names, MY_LAT_NR);
+    if (IS_ERR(my_lat)) {
+        printk(KERN_WARNING "Failed to register /proc/u2k/ioctl\n");
+        my_lat = NULL;
+    }
+
+    if (publish_ms) {
+        schedule_delayed_work(&my_publish_work, msecs_to_jiffies(publish_ms));
+    }
+
     printk(KERN_INFO "my_ioctl_driver loaded successfully\n");
     return 0;
 }
@@ -127,6 +614,9 @@ static int __init my_init(void) {
  */
 static void __exit my_exit(void) {
     device_destroy(my_class, dev_num); // 移除设备文件
+    cancel_delayed_work_sync(&my_publish_work); // 停止定时发布，之后不再有写者
+    free_page((unsigned long)my_shared);        // 没有打开的文件，也就没有映射
+    u2k_lat_unregister(my_lat);        // 模块卸载时已没有打开的文件，不会再有新的记录
     class_destroy(my_class);           // 销毁设备类
     cdev_del(&my_cdev);                // 移除 cdev
     unregister_chrdev_region(dev_num, 1); // 释放设备号
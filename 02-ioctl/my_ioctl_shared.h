@@ -0,0 +1,89 @@
+#ifndef MY_IOCTL_SHARED_H
+#define MY_IOCTL_SHARED_H
+
+/*
+ * 用户态读取 my_ioctl_dev 只读共享页的辅助函数，纯头文件，不需要系统调用（映射之后）。
+ *
+ *   const struct my_ioctl_shared *sh = my_shared_map(fd);
+ *   uint64_t v = my_shared_value(sh, 0);       // 等价于 IOCTL_GET_VALUE
+ *
+ * 需要同一时刻的多个字段时，用 begin/retry 包住读取，或直接取整个快照：
+ *   do {
+ *       seq = my_shared_read_begin(sh);
+ *       a = __atomic_load_n(&sh->values[1], __ATOMIC_RELAXED);
+ *       b = __atomic_load_n(&sh->values[2], __ATOMIC_RELAXED);
+ *   } while (my_shared_read_retry(sh, seq));
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "my_ioctl.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define my_shared_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define my_shared_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define my_shared_relax() do { } while (0)
+#endif
+
+// 只读映射共享页，失败返回 NULL
+static inline const struct my_ioctl_shared *my_shared_map(int fd) {
+    void *p = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+
+    return p == MAP_FAILED ? NULL : (const struct my_ioctl_shared *)p;
+}
+
+static inline void my_shared_unmap(const struct my_ioctl_shared *sh) {
+    munmap((void *)sh, sysconf(_SC_PAGESIZE));
+}
+
+// 等到没有写者（seq 为偶数）并返回 seq；acquire：之后读到的数据不早于这个 seq
+static inline uint32_t my_shared_read_begin(const struct my_ioctl_shared *sh) {
+    uint32_t seq;
+
+    while ((seq = __atomic_load_n(&sh->seq, __ATOMIC_ACQUIRE)) & 1) {
+        my_shared_relax();
+    }
+    return seq;
+}
+
+// 读取期间有写者时返回非 0，调用者需要重新读取；fence 保证数据的读取先于再次读 seq
+static inline int my_shared_read_retry(const struct my_ioctl_shared *sh, uint32_t seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&sh->seq, __ATOMIC_RELAXED) != seq;
+}
+
+// 读取一个槽位的值，idx 小于 MY_IOCTL_NR_SHARED
+static inline uint64_t my_shared_value(const struct my_ioctl_shared *sh, unsigned int idx) {
+    uint32_t seq;
+    uint64_t v;
+
+    do {
+        seq = my_shared_read_begin(sh);
+        v = __atomic_load_n(&sh->values[idx], __ATOMIC_RELAXED);
+    } while (my_shared_read_retry(sh, seq));
+    return v;
+}
+
+// 复制整个共享页的一致快照（seq 之后的字段都是 64 位），返回本次读取的 seq
+static inline uint32_t my_shared_snapshot(const struct my_ioctl_shared *sh, struct my_ioctl_shared *out) {
+    const size_t off = offsetof(struct my_ioctl_shared, updates);
+    const uint64_t *src = (const uint64_t *)((const char *)sh + off);
+    uint64_t *dst = (uint64_t *)((char *)out + off);
+    uint32_t seq;
+
+    do {
+        seq = my_shared_read_begin(sh);
+        out->nr_values = __atomic_load_n(&sh->nr_values, __ATOMIC_RELAXED);
+        for (size_t i = 0; i < (sizeof(*sh) - off) / sizeof(uint64_t); i++) {
+            dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        }
+    } while (my_shared_read_retry(sh, seq));
+    out->seq = seq;
+    return seq;
+}
+
+#endif // MY_IOCTL_SHARED_H
@@ -3,15 +3,335 @@
 #include <fcntl.h>      // 文件控制（open()）
 #include <unistd.h>     // UNIX 标准头文件，包含 close()
 #include <sys/ioctl.h>  // ioctl 相关的系统调用
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "my_ioctl.h"   // 与内核模块共享的 IOCTL 定义
+#include "my_ioctl_shared.h" // 只读共享页的读取函数
 
 // 设备文件路径，用户态程序通过它访问内核驱动
 #define DEVICE_PATH "/dev/my_ioctl_dev"
 
-// 定义 IOCTL 命令
-#define IOCTL_GET_VALUE _IOR('a', 1, int *) // 读取设备中的整数值
-#define IOCTL_SET_VALUE _IOW('a', 2, int *) // 设置设备中的整数值
+#define BENCH_OPS 1000000 // 每种批量大小执行的命令总数
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * 批量 IOCTL 基准：先测逐条 ioctl 的吞吐，再测批量大小从 1 到 1024 时的吞吐。
+ * 每条命令本身几乎不做事，因此结果主要反映系统调用进出内核的开销被摊薄的程度。
+ */
+static int batch_bench(int fd) {
+    struct my_ioctl_batch_entry *entries = calloc(1024, sizeof(*entries));
+    struct my_ioctl_batch batch;
+    uint64_t start;
+    int value;
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_OPS; i++) {
+        if (ioctl(fd, IOCTL_GET_VALUE, &value) < 0) {
+            perror("ioctl get");
+            free(entries);
+            return EXIT_FAILURE;
+        }
+    }
+    printf("%-12s %12.0f ops/s\n", "single", BENCH_OPS / ((now_ns() - start) / 1e9));
+
+    for (uint32_t size = 1; size <= 1024; size *= 2) {
+        for (uint32_t i = 0; i < size; i++) {
+            entries[i].cmd = (i & 1) ? IOCTL_SET_VALUE : IOCTL_GET_VALUE;
+            entries[i].arg = i;
+        }
+        batch.entries = (uintptr_t)entries;
+        batch.count = size;
+
+        start = now_ns();
+        for (int done = 0; done < BENCH_OPS; done += size) {
+            if (ioctl(fd, IOCTL_BATCH, &batch) < 0 || batch.done != size) {
+                perror("ioctl batch");
+                free(entries);
+                return EXIT_FAILURE;
+            }
+        }
+        printf("batch %-6u %12.0f ops/s\n", size, BENCH_OPS / ((now_ns() - start) / 1e9));
+    }
+
+    free(entries);
+    return EXIT_SUCCESS;
+}
+
+#define CONTEND_OPS 200000 // 每个线程执行的 FETCH_ADD 次数
+
+struct contend_arg {
+    pthread_t tid;
+    int fd;
+    uint32_t slot;
+    int errors;
+};
+
+static void *contend_worker(void *p) {
+    struct contend_arg *a = p;
+    struct my_ioctl_slot_op op = { .slot = a->slot, .arg = 1 };
+
+    for (int i = 0; i < CONTEND_OPS; i++) {
+        if (ioctl(a->fd, IOCTL_SLOT_FETCH_ADD, &op) < 0) {
+            a->errors++;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 原子槽位竞争测试：N 个线程同时对同一个槽位 / 各自独立的槽位执行 FETCH_ADD，
+ * 报告总吞吐并检查最终计数没有丢失更新。
+ */
+static int contend_bench(int fd, int threads) {
+    struct contend_arg *args = calloc(threads, sizeof(*args));
+    int ret = EXIT_SUCCESS;
+
+    for (int shared = 1; shared >= 0; shared--) {
+        struct my_ioctl_slot_op op = { 0 };
+        uint64_t start, expected = 0, total = 0;
+        int errors = 0;
 
-int main() {
+        // 先把用到的槽位清零
+        for (int i = 0; i < threads; i++) {
+            op.slot = shared ? 1 : 1 + i % (MY_IOCTL_NR_SLOTS - 1);
+            ioctl(fd, IOCTL_SLOT_SET, &op);
+        }
+
+        start = now_ns();
+        for (int i = 0; i < threads; i++) {
+            args[i].fd = fd;
+            args[i].slot = shared ? 1 : 1 + i % (MY_IOCTL_NR_SLOTS - 1);
+            args[i].errors = 0;
+            pthread_create(&args[i].tid, NULL, contend_worker, &args[i]);
+        }
+        for (int i = 0; i < threads; i++) {
+            pthread_join(args[i].tid, NULL);
+            errors += args[i].errors;
+        }
+        double secs = (now_ns() - start) / 1e9;
+
+        // 校验：所有用到的槽位之和应等于总操作数
+        expected = (uint64_t)threads * CONTEND_OPS;
+        for (uint32_t slot = 1; slot < MY_IOCTL_NR_SLOTS && (shared ? slot == 1 : slot <= (uint32_t)threads); slot++) {
+            op.slot = slot;
+            ioctl(fd, IOCTL_SLOT_GET, &op);
+            total += op.result;
+        }
+
+        printf("%-9s slots, %3d threads: %12.0f ops/s, counted %llu / %llu, %d errors\n",
+               shared ? "one" : "separate", threads, expected / secs,
+               (unsigned long long)total, (unsigned long long)expected, errors);
+        if (total != expected || errors) {
+            ret = EXIT_FAILURE;
+        }
+    }
+
+    free(args);
+    return ret;
+}
+
+#define STATS_MODE_PARAM "/sys/module/my_ioctl_driver/parameters/stats_mode"
+
+static int set_stats_mode(int mode) {
+    FILE *f = fopen(STATS_MODE_PARAM, "w");
+
+    if (!f) {
+        perror("open " STATS_MODE_PARAM);
+        return -1;
+    }
+    fprintf(f, "%d\n", mode);
+    return fclose(f);
+}
+
+/*
+ * 统计计数器扩展性测试：线程各自操作独立的槽位，唯一的共享数据就是驱动的统计计数器。
+ * 依次切换 stats_mode = 0（不统计）/ 1（per-CPU）/ 2（共享原子变量），线程数按 2 的幂递增，
+ * per-CPU 计数器的吞吐应与不统计时接近，共享原子计数器则随线程数增加而明显下降。
+ */
+static int stats_bench(int fd, int max_threads) {
+    static const char *names[] = { "off", "percpu", "atomic" };
+    struct contend_arg *args = calloc(max_threads, sizeof(*args));
+    struct my_ioctl_stats st;
+    int ret = EXIT_SUCCESS;
+
+    for (int mode = 0; mode < 3; mode++) {
+        if (set_stats_mode(mode) < 0) {
+            ret = EXIT_FAILURE;
+            break;
+        }
+        for (int n = 1; n <= max_threads; n *= 2) {
+            uint64_t start = now_ns();
+            int errors = 0;
+
+            for (int i = 0; i < n; i++) {
+                args[i].fd = fd;
+                args[i].slot = 1 + i % (MY_IOCTL_NR_SLOTS - 1);
+                args[i].errors = 0;
+                pthread_create(&args[i].tid, NULL, contend_worker, &args[i]);
+            }
+            for (int i = 0; i < n; i++) {
+                pthread_join(args[i].tid, NULL);
+                errors += args[i].errors;
+            }
+            double secs = (now_ns() - start) / 1e9;
+
+            printf("stats %-6s %3d threads: %12.0f ops/s (%10.0f per thread), %d errors\n",
+                   names[mode], n, (double)n * CONTEND_OPS / secs, CONTEND_OPS / secs, errors);
+            if (errors) {
+                ret = EXIT_FAILURE;
+            }
+        }
+    }
+    set_stats_mode(1);
+
+    if (ioctl(fd, IOCTL_GET_STATS, &st) < 0) {
+        perror("ioctl get stats");
+        ret = EXIT_FAILURE;
+    } else {
+        printf("totals: get %llu, set %llu, atomic %llu, batch %llu (%llu entries), %llu bytes\n",
+               (unsigned long long)st.get, (unsigned long long)st.set, (unsigned long long)st.atomic,
+               (unsigned long long)st.batch, (unsigned long long)st.batch_entries,
+               (unsigned long long)st.bytes);
+    }
+
+    free(args);
+    return ret;
+}
+
+#define SHARED_READS (100 * BENCH_OPS) // 共享页读取次数
+#define SHARED_WRITER_SECS 1           // 并发测试的时长
+
+static volatile uint64_t shared_sink;
+
+struct shared_writer_arg {
+    pthread_t tid;
+    int fd;
+    volatile int stop;
+    uint64_t writes;
+};
+
+// 写者：不断递增 1 号槽位并立即发布，让读者与共享页的更新并发
+static void *shared_writer(void *p) {
+    struct shared_writer_arg *a = p;
+    struct my_ioctl_slot_op op = { .slot = 1 };
+
+    while (!a->stop) {
+        op.arg = ++a->writes;
+        ioctl(a->fd, IOCTL_SLOT_SET, &op);
+        ioctl(a->fd, IOCTL_SHARED_PUBLISH);
+    }
+    return NULL;
+}
+
+/*
+ * 只读共享页测试：
+ *   1. SET 与 FETCH_ADD 的结果在 IOCTL_SHARED_PUBLISH 之后可见，映射不允许写；
+ *   2. 对比 IOCTL_GET_VALUE 与直接读共享页的单次耗时；
+ *   3. 一个线程持续写入时，读者读到的值和发布次数单调不减，并统计因并发写入而重试的次数。
+ */
+static int shared_bench(int fd) {
+    const struct my_ioctl_shared *sh = my_shared_map(fd);
+    struct my_ioctl_slot_op op = { .slot = 3, .arg = 1000 };
+    struct shared_writer_arg writer = { .fd = fd };
+    struct my_ioctl_shared snap = { 0 };
+    uint64_t start, sum = 0, reads = 0, retries = 0, last_value = 0, last_updates = 0;
+    int value = 4321, ret = EXIT_SUCCESS;
+
+    if (!sh) {
+        perror("mmap shared page");
+        return EXIT_FAILURE;
+    }
+    if (mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) != MAP_FAILED) {
+        fprintf(stderr, "writable mapping of the shared page was not rejected\n");
+        ret = EXIT_FAILURE;
+    }
+
+    ioctl(fd, IOCTL_SET_VALUE, &value);
+    ioctl(fd, IOCTL_SLOT_SET, &op);
+    ioctl(fd, IOCTL_SHARED_PUBLISH);
+    if (my_shared_value(sh, 0) != 4321 || my_shared_value(sh, 3) != 1000) {
+        fprintf(stderr, "SET not visible: values[0] %llu, values[3] %llu\n",
+                (unsigned long long)my_shared_value(sh, 0), (unsigned long long)my_shared_value(sh, 3));
+        ret = EXIT_FAILURE;
+    }
+    op.arg = 1;
+    ioctl(fd, IOCTL_SLOT_FETCH_ADD, &op);
+    ioctl(fd, IOCTL_SHARED_PUBLISH);
+    my_shared_snapshot(sh, &snap);
+    if (snap.values[3] != 1001 || snap.nr_values != MY_IOCTL_NR_SHARED) {
+        fprintf(stderr, "publish: values[3] %llu, nr_values %u\n", (unsigned long long)snap.values[3],
+                snap.nr_values);
+        ret = EXIT_FAILURE;
+    }
+    printf("shared page: %u values, %llu updates, stats get %llu set %llu atomic %llu\n", snap.nr_values,
+           (unsigned long long)snap.updates, (unsigned long long)snap.stats.get,
+           (unsigned long long)snap.stats.set, (unsigned long long)snap.stats.atomic);
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_OPS; i++) {
+        ioctl(fd, IOCTL_GET_VALUE, &value);
+    }
+    printf("%-20s %8.1f ns/op\n", "IOCTL_GET_VALUE", (double)(now_ns() - start) / BENCH_OPS);
+
+    start = now_ns();
+    for (long i = 0; i < SHARED_READS; i++) {
+        sum += my_shared_value(sh, 0);
+    }
+    printf("%-20s %8.1f ns/op\n", "shared value", (double)(now_ns() - start) / SHARED_READS);
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_OPS; i++) {
+        sum += my_shared_snapshot(sh, &snap);
+    }
+    printf("%-20s %8.1f ns/op (%zu bytes)\n", "shared snapshot", (double)(now_ns() - start) / BENCH_OPS,
+           sizeof(snap));
+
+    // 并发写入时的读者
+    pthread_create(&writer.tid, NULL, shared_writer, &writer);
+    start = now_ns();
+    while (now_ns() - start < SHARED_WRITER_SECS * 1000000000ULL) {
+        uint64_t v, updates;
+        uint32_t seq;
+
+        for (;;) {
+            seq = my_shared_read_begin(sh);
+            v = __atomic_load_n(&sh->values[1], __ATOMIC_RELAXED);
+            updates = __atomic_load_n(&sh->updates, __ATOMIC_RELAXED);
+            if (!my_shared_read_retry(sh, seq)) {
+                break;
+            }
+            retries++;
+        }
+        if (v < last_value || updates < last_updates) {
+            fprintf(stderr, "went backwards: value %llu -> %llu, updates %llu -> %llu\n",
+                    (unsigned long long)last_value, (unsigned long long)v, (unsigned long long)last_updates,
+                    (unsigned long long)updates);
+            ret = EXIT_FAILURE;
+            break;
+        }
+        last_value = v;
+        last_updates = updates;
+        reads++;
+    }
+    writer.stop = 1;
+    pthread_join(writer.tid, NULL);
+    printf("with a writer: %llu reads, %llu writes, %llu retries (%.4f per read)\n", (unsigned long long)reads,
+           (unsigned long long)writer.writes, (unsigned long long)retries, reads ? (double)retries / reads : 0.0);
+
+    my_shared_unmap(sh);
+    shared_sink = sum;  // 防止读取被编译器优化掉
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
     // 打开设备文件，O_RDWR 允许读写
     int fd = open(DEVICE_PATH, O_RDWR);
     if (fd < 0) {
@@ -19,6 +339,34 @@ int main() {
         return EXIT_FAILURE;
     }
 
+    // ./user_ioctl_test bench：批量 IOCTL 吞吐测试
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int ret = batch_bench(fd);
+        close(fd);
+        return ret;
+    }
+
+    // ./user_ioctl_test contend [线程数]：原子槽位竞争测试
+    if (argc > 1 && strcmp(argv[1], "contend") == 0) {
+        int ret = contend_bench(fd, argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN));
+        close(fd);
+        return ret;
+    }
+
+    // ./user_ioctl_test stats [最大线程数]：统计计数器扩展性测试
+    if (argc > 1 && strcmp(argv[1], "stats") == 0) {
+        int ret = stats_bench(fd, argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN));
+        close(fd);
+        return ret;
+    }
+
+    // ./user_ioctl_test shared：只读共享页与 IOCTL_GET_VALUE 的对比
+    if (argc > 1 && strcmp(argv[1], "shared") == 0) {
+        int ret = shared_bench(fd);
+        close(fd);
+        return ret;
+    }
+
     // 要写入设备的值
     int value = 100;
     printf("Setting value to %d\n", value);
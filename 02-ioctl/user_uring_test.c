@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "my_ioctl.h"
+
+/*
+ * 通过 io_uring 直通命令（IORING_OP_URING_CMD）访问 my_ioctl_dev，只使用原始系统调用，不依赖 liburing。
+ *   ./user_uring_test          功能测试 + 与逐条 ioctl 的吞吐对比（队列深度 1~256）
+ *   ./user_uring_test sqpoll   同上，ring 以 IORING_SETUP_SQPOLL 创建，提交不需要系统调用
+ */
+
+#define DEVICE_PATH "/dev/my_ioctl_dev"
+#define RING_ENTRIES 256
+#define BENCH_OPS 1000000
+#define SQE_SIZE 128  // IORING_SETUP_SQE128
+#define CQE_SIZE 32   // IORING_SETUP_CQE32
+
+struct uring {
+    int fd;
+    int sqpoll;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_flags, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    char *sqes;  // SQE_SIZE 字节一项
+    char *cqes;  // CQE_SIZE 字节一项
+    unsigned sq_local_tail;  // 已填写但尚未提交的位置
+    unsigned to_submit;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int uring_setup(struct uring *r, unsigned entries, int sqpoll) {
+    struct io_uring_params p;
+    size_t sq_len, cq_len;
+    char *sq, *cq;
+
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+    p.flags = IORING_SETUP_SQE128 | IORING_SETUP_CQE32;
+    if (sqpoll) {
+        p.flags |= IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = 1000;  // 空闲 1 秒后 SQPOLL 线程休眠
+    }
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) {
+        perror("io_uring_setup");
+        return -1;
+    }
+    r->sqpoll = sqpoll;
+
+    sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len = p.cq_off.cqes + p.cq_entries * CQE_SIZE;
+    sq = mmap(NULL, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    cq = mmap(NULL, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    r->sqes = mmap(NULL, p.sq_entries * SQE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || r->sqes == MAP_FAILED) {
+        perror("mmap io_uring");
+        close(r->fd);
+        return -1;
+    }
+
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_flags = (unsigned *)(sq + p.sq_off.flags);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = cq + p.cq_off.cqes;
+    r->sq_local_tail = *r->sq_tail;
+    return 0;
+}
+
+// 填写一条 URING_CMD SQE，返回后尚未提交
+static void uring_prep_cmd(struct uring *r, int devfd, uint32_t cmd, const struct my_ioctl_uring_cmd *payload,
+                           uint64_t user_data) {
+    unsigned idx = r->sq_local_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)(r->sqes + (size_t)idx * SQE_SIZE);
+
+    memset(sqe, 0, SQE_SIZE);
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = devfd;
+    sqe->cmd_op = cmd;
+    sqe->user_data = user_data;
+    memcpy(sqe->cmd, payload, sizeof(*payload));
+    r->sq_array[idx] = idx;
+    r->sq_local_tail++;
+    r->to_submit++;
+}
+
+/*
+ * 发布 SQ 尾指针并按需进入内核：普通模式下一次 io_uring_enter 提交全部 SQE 并等待 wait_nr 个完成；
+ * SQPOLL 模式下只有内核线程已休眠时才需要系统调用唤醒它，完成由 uring_wait 轮询 CQ 获得。
+ */
+static int uring_submit(struct uring *r, unsigned wait_nr) {
+    unsigned flags = 0;
+    int ret;
+
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+    if (r->sqpoll) {
+        r->to_submit = 0;
+        if (!(__atomic_load_n(r->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)) {
+            return 0;
+        }
+        flags |= IORING_ENTER_SQ_WAKEUP;
+        wait_nr = 0;
+    } else if (wait_nr) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    ret = syscall(__NR_io_uring_enter, r->fd, r->sqpoll ? 0 : r->to_submit, wait_nr, flags, NULL, 0);
+    if (ret < 0) {
+        perror("io_uring_enter");
+        return -1;
+    }
+    r->to_submit = 0;
+    return 0;
+}
+
+// 取出一个 CQE，没有时返回 NULL；调用者处理完后调用 uring_cqe_seen
+static struct io_uring_cqe *uring_peek(struct uring *r) {
+    unsigned head = *r->cq_head;
+
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return (struct io_uring_cqe *)(r->cqes + (size_t)(head & *r->cq_mask) * CQE_SIZE);
+}
+
+static void uring_cqe_seen(struct uring *r) {
+    __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// 等待一个 CQE：普通模式下完成已由 uring_submit 等到，SQPOLL 模式下轮询
+static struct io_uring_cqe *uring_wait(struct uring *r) {
+    struct io_uring_cqe *cqe;
+
+    while (!(cqe = uring_peek(r))) {
+        if (!r->sqpoll && syscall(__NR_io_uring_enter, r->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+            perror("io_uring_enter");
+            return NULL;
+        }
+    }
+    return cqe;
+}
+
+// 提交一条命令并同步等待结果，返回 cqe->res，结果写入 *result
+static int uring_cmd_sync(struct uring *r, int devfd, uint32_t cmd, struct my_ioctl_uring_cmd payload,
+                          uint64_t *result) {
+    struct io_uring_cqe *cqe;
+    int res;
+
+    uring_prep_cmd(r, devfd, cmd, &payload, cmd);
+    if (uring_submit(r, 1) < 0 || !(cqe = uring_wait(r))) {
+        return -1;
+    }
+    res = cqe->res;
+    if (result) {
+        *result = cqe->big_cqe[0];
+    }
+    uring_cqe_seen(r);
+    return res;
+}
+
+// 功能测试：SET / FETCH_ADD / CAS / GET 以及一个批量命令都经由 io_uring 提交
+static int func_test(struct uring *r, int devfd) {
+    struct my_ioctl_batch_entry entries[2] = {
+        { .cmd = IOCTL_SLOT_FETCH_ADD, .slot = 2, .arg = 100 },
+        { .cmd = IOCTL_SLOT_GET, .slot = 2 },
+    };
+    struct my_ioctl_batch batch = { .entries = (uintptr_t)entries, .count = 2 };
+    uint64_t old = 0, now = 0;
+    int res;
+
+    res = uring_cmd_sync(r, devfd, IOCTL_SLOT_SET, (struct my_ioctl_uring_cmd){ .slot = 2, .arg = 10 }, NULL);
+    if (res < 0) {
+        fprintf(stderr, "uring SLOT_SET failed: %s\n", strerror(-res));
+        return -1;
+    }
+    uring_cmd_sync(r, devfd, IOCTL_SLOT_FETCH_ADD, (struct my_ioctl_uring_cmd){ .slot = 2, .arg = 5 }, &old);
+    uring_cmd_sync(r, devfd, IOCTL_SLOT_CAS, (struct my_ioctl_uring_cmd){ .slot = 2, .arg = 15, .arg2 = 42 }, NULL);
+    uring_cmd_sync(r, devfd, IOCTL_SLOT_GET, (struct my_ioctl_uring_cmd){ .slot = 2 }, &now);
+    printf("uring: set 10, fetch_add 5 -> old %llu, cas 15->42, get -> %llu\n",
+           (unsigned long long)old, (unsigned long long)now);
+    if (old != 10 || now != 42) {
+        return -1;
+    }
+
+    res = uring_cmd_sync(r, devfd, IOCTL_BATCH, (struct my_ioctl_uring_cmd){ .arg = (uintptr_t)&batch }, NULL);
+    printf("uring batch: res %d, done %u, fetch_add old %llu, get %llu\n", res, batch.done,
+           (unsigned long long)entries[0].result, (unsigned long long)entries[1].result);
+    return res == 0 && batch.done == 2 && entries[1].result == 142 ? 0 : -1;
+}
+
+// 逐条 ioctl 的基线
+static double ioctl_bench(int devfd) {
+    struct my_ioctl_slot_op op = { .slot = 3, .arg = 1 };
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < BENCH_OPS; i++) {
+        ioctl(devfd, IOCTL_SLOT_FETCH_ADD, &op);
+    }
+    return BENCH_OPS / ((now_ns() - start) / 1e9);
+}
+
+// 每轮提交 depth 条 FETCH_ADD，再收齐 depth 个完成
+static double uring_bench(struct uring *r, int devfd, unsigned depth, int *errors) {
+    struct my_ioctl_uring_cmd payload = { .slot = 3, .arg = 1 };
+    uint64_t start = now_ns();
+    int done;
+
+    for (done = 0; done < BENCH_OPS; done += depth) {
+        for (unsigned i = 0; i < depth; i++) {
+            uring_prep_cmd(r, devfd, IOCTL_SLOT_FETCH_ADD, &payload, i);
+        }
+        if (uring_submit(r, depth) < 0) {
+            (*errors)++;
+            break;
+        }
+        for (unsigned i = 0; i < depth; i++) {
+            struct io_uring_cqe *cqe = uring_wait(r);
+
+            if (!cqe) {
+                (*errors)++;
+                return 0;
+            }
+            if (cqe->res < 0) {
+                (*errors)++;
+            }
+            uring_cqe_seen(r);
+        }
+    }
+    return done / ((now_ns() - start) / 1e9);
+}
+
+int main(int argc, char *argv[]) {
+    int sqpoll = argc > 1 && strcmp(argv[1], "sqpoll") == 0;
+    struct uring ring;
+    int devfd, errors = 0;
+
+    devfd = open(DEVICE_PATH, O_RDWR);
+    if (devfd < 0) {
+        perror("open");
+        return EXIT_FAILURE;
+    }
+    if (uring_setup(&ring, RING_ENTRIES, sqpoll) < 0) {
+        close(devfd);
+        return EXIT_FAILURE;
+    }
+
+    if (func_test(&ring, devfd) < 0) {
+        fprintf(stderr, "uring functional test failed\n");
+        errors++;
+    }
+
+    printf("%-24s %12.0f ops/s\n", "ioctl", ioctl_bench(devfd));
+    for (unsigned depth = 1; depth <= RING_ENTRIES; depth *= 4) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "uring%s depth %u", sqpoll ? " sqpoll" : "", depth);
+        printf("%-24s %12.0f ops/s\n", name, uring_bench(&ring, devfd, depth, &errors));
+    }
+
+    close(ring.fd);
+    close(devfd);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -5,119 +5,1044 @@
 #include <linux/device.h>    // 设备类
 #include <linux/uaccess.h>   // 用户空间数据交互 API（copy_to_user, copy_from_user）
 #include <linux/slab.h>      // kmalloc/kfree
+#include <linux/kfifo.h>     // 内核 FIFO
+#include <linux/wait.h>      // 等待队列
+#include <linux/poll.h>      // poll/epoll
+#include <linux/mutex.h>
+#include <linux/rcupdate.h> // RCU
+#include <linux/refcount.h>
+#include <linux/uio.h>       // iov_iter
+#include <linux/scatterlist.h>
+#include <linux/splice.h>    // splice_read/splice_write 辅助函数
+#include <linux/version.h>
+#include <linux/xarray.h>    // 稀疏页存储
+#include <linux/rwsem.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/mm.h>        // pin_user_pages_fast
+#include <linux/bvec.h>
+#include <linux/nospec.h>    // array_index_nospec
+#include "readwrite_demo.h"  // 固定缓冲区的 ioctl 定义
+#include "u2k_stats.h"      // per-CPU 统计计数器
+#include "u2k_lat.h"        // 延迟直方图（u2k_common.ko）
+#include "u2k_trace.h"      // 跟踪点（u2k_common.ko）
 
 #define DEVICE_NAME "readwrite_demo"  // 设备名称
 #define CLASS_NAME "rw_class"         // 设备类别
-#define BUFFER_SIZE 1024              // 设备缓冲区大小
+#define BUFFER_SIZE 1024              // 私有缓冲区 / 快照的最大长度
 
-static dev_t dev_num;         // 设备号
+/*
+ * splice 支持：设备 -> 管道 由 read_iter 直接填充管道页，管道 -> 设备 由 write_iter 直接读取管道页，
+ * 数据不再经过用户态缓冲区。6.5 起 generic_file_splice_read 被 copy_splice_read 取代。
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,5,0)
+#define RW_SPLICE_READ copy_splice_read
+#else
+#define RW_SPLICE_READ generic_file_splice_read
+#endif
+
+/*
+ * 同一个驱动导出多个次设备号，每个对应一种并发模型：
+ *   /dev/readwrite_demo       阻塞式 FIFO
+ *   /dev/readwrite_demo_priv  每个打开的文件拥有私有缓冲区（filp->private_data）
+ *   /dev/readwrite_demo_snap  全局共享快照，读者走 RCU，完全无锁
+ *   /dev/readwrite_demo_store 可按偏移读写的稀疏存储，按页分配
+ */
+enum {
+    RW_MINOR_FIFO,
+    RW_MINOR_PRIV,
+    RW_MINOR_SNAP,
+    RW_MINOR_STORE,
+    RW_NR_DEVS,
+};
+
+// FIFO 容量（字节），kfifo 会向上取整到 2 的幂
+static unsigned int fifo_size = 65536;
+module_param(fifo_size, uint, 0444);
+MODULE_PARM_DESC(fifo_size, "Capacity of the readwrite_demo FIFO in bytes");
+
+static dev_t dev_num;         // 起始设备号
 static struct cdev rw_cdev;   // 字符设备
 static struct class *rw_class;  // 设备类
-static struct device *rw_device; // 设备指针
-static char *kernel_buffer;  // 内核缓冲区
-static int data_size = 0;  // 当前数据长度
+static struct kfifo rw_fifo;  // 字节流 FIFO
+static DEFINE_MUTEX(rw_lock); // 保护 FIFO 的读写
+static DECLARE_WAIT_QUEUE_HEAD(rw_readq);  // 等待数据到达的读者
+static DECLARE_WAIT_QUEUE_HEAD(rw_writeq); // 等待空间释放的写者
+
+// 所有次设备共用的读写统计，热路径上只修改本 CPU 的副本，卸载时汇总打印
+enum {
+    RW_STAT_READ,
+    RW_STAT_READ_BYTES,
+    RW_STAT_WRITE,
+    RW_STAT_WRITE_BYTES,
+    RW_STAT_NR,
+};
+static DEFINE_PER_CPU(struct u2k_stats, rw_stats);
+
+/*
+ * 延迟直方图 /proc/u2k/readwrite，每个次设备的读、写各一行，下标为 minor * 2 + 方向，
+ * 便于直接比较几种并发模型。阻塞式 FIFO 的耗时包含等待数据/空间的时间。
+ * 每个读写函数入口调用 rw_begin，所有返回路径都经过 rw_account，
+ * 两者分别触发 u2k_rw_enter / u2k_rw_exit 跟踪点。
+ */
+#define RW_LAT_OP(minor, write) ((minor) * 2 + (write))
+#define RW_LAT_NR (RW_NR_DEVS * 2)
+static const char *const rw_lat_names[RW_LAT_NR] = {
+    "fifo_read", "fifo_write", "priv_read", "priv_write",
+    "snap_read", "snap_write", "store_read", "store_write",
+};
+static struct u2k_lat *rw_lat;
+
+// 读写入口：触发跟踪点并返回计时起点
+static u64 rw_begin(int lat_op, size_t count, loff_t pos) {
+    trace_u2k_rw_enter(lat_op / 2, lat_op & 1, count, pos);
+    return u2k_lat_start();
+}
+
+// 记录一次读或写的耗时，成功时再累加次数与字节数；原样返回 ret，便于直接包在 return 语句上
+static ssize_t rw_account(int lat_op, u64 start, ssize_t ret) {
+    int stat = (lat_op & 1) ? RW_STAT_WRITE : RW_STAT_READ;
+
+    u2k_lat_end(rw_lat, lat_op, start);
+    trace_u2k_rw_exit(lat_op / 2, lat_op & 1, ret);
+    if (ret > 0) {
+        u2k_stats_inc(rw_stats, stat);
+        u2k_stats_add(rw_stats, stat + 1, ret);
+    }
+    return ret;
+}
+
+// 打开 FIFO：流式设备，不支持 lseek/pread/pwrite
+static int rw_fifo_open(struct inode *inode, struct file *filp) {
+    return stream_open(inode, filp);
+}
+
+// 按 IOCB_NOWAIT 语义获取互斥锁：不允许阻塞时（如 io_uring 的非阻塞尝试）只尝试一次
+static int rw_mutex_lock(struct mutex *lock, struct kiocb *iocb) {
+    if (iocb->ki_flags & IOCB_NOWAIT) {
+        return mutex_trylock(lock) ? 0 : -EAGAIN;
+    }
+    return mutex_lock_interruptible(lock) ? -ERESTARTSYS : 0;
+}
+
+// O_NONBLOCK 打开或本次请求带 IOCB_NOWAIT 时都不允许等待
+static bool rw_nowait(struct kiocb *iocb) {
+    return (iocb->ki_filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT);
+}
+
+/*
+ * 设备读取操作：FIFO 为空时阻塞，非阻塞模式下返回 -EAGAIN。
+ * kfifo 中的数据最多分布在两段连续内存中，用 kfifo_dma_out_prepare 取得这两段，
+ * 再逐段 copy_to_iter 到用户的分散缓冲区（readv/io_uring 一次调用即可填满多个 iovec）。
+ */
+static ssize_t rw_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+    const int op = RW_LAT_OP(RW_MINOR_FIFO, 0);
+    u64 start = rw_begin(op, iov_iter_count(to), iocb->ki_pos);
+    size_t count = iov_iter_count(to), copied = 0;
+    struct scatterlist sg[2];
+    unsigned int nents, i;
+    int ret;
+
+    if (count == 0) {
+        return rw_account(op, start, 0);
+    }
+
+    ret = rw_mutex_lock(&rw_lock, iocb);
+    if (ret) {
+        return rw_account(op, start, ret);
+    }
+    while (kfifo_is_empty(&rw_fifo)) {
+        mutex_unlock(&rw_lock);
+        if (rw_nowait(iocb)) {
+            return rw_account(op, start, -EAGAIN);
+        }
+        if (wait_event_interruptible(rw_readq, !kfifo_is_empty(&rw_fifo))) {
+            return rw_account(op, start, -ERESTARTSYS);  // 被信号打断
+        }
+        if (mutex_lock_interruptible(&rw_lock)) {
+            return rw_account(op, start, -ERESTARTSYS);
+        }
+    }
+
+    sg_init_table(sg, ARRAY_SIZE(sg));
+    nents = kfifo_dma_out_prepare(&rw_fifo, sg, ARRAY_SIZE(sg), min_t(size_t, count, UINT_MAX));
+    for (i = 0; i < nents; i++) {
+        size_t n = copy_to_iter(sg_virt(&sg[i]), sg[i].length, to);
+
+        copied += n;
+        if (n < sg[i].length) {
+            break;  // 用户缓冲区缺页失败，只提交已拷贝的部分
+        }
+    }
+    kfifo_dma_out_finish(&rw_fifo, copied);
+    mutex_unlock(&rw_lock);
+    if (!copied) {
+        return rw_account(op, start, -EFAULT);  // 复制失败
+    }
+
+    wake_up_interruptible(&rw_writeq);  // 腾出了空间，唤醒写者
+    return rw_account(op, start, copied);  // 返回实际读取的字节数
+}
+
+// 设备写入操作：FIFO 已满时阻塞，非阻塞模式下返回 -EAGAIN；空间不足时部分写入
+static ssize_t rw_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+    const int op = RW_LAT_OP(RW_MINOR_FIFO, 1);
+    u64 start = rw_begin(op, iov_iter_count(from), iocb->ki_pos);
+    size_t count = iov_iter_count(from), copied = 0;
+    struct scatterlist sg[2];
+    unsigned int nents, i;
+    int ret;
+
+    if (count == 0) {
+        return rw_account(op, start, 0);
+    }
+
+    ret = rw_mutex_lock(&rw_lock, iocb);
+    if (ret) {
+        return rw_account(op, start, ret);
+    }
+    while (kfifo_is_full(&rw_fifo)) {
+        mutex_unlock(&rw_lock);
+        if (rw_nowait(iocb)) {
+            return rw_account(op, start, -EAGAIN);
+        }
+        if (wait_event_interruptible(rw_writeq, !kfifo_is_full(&rw_fifo))) {
+            return rw_account(op, start, -ERESTARTSYS);
+        }
+        if (mutex_lock_interruptible(&rw_lock)) {
+            return rw_account(op, start, -ERESTARTSYS);
+        }
+    }
+
+    sg_init_table(sg, ARRAY_SIZE(sg));
+    nents = kfifo_dma_in_prepare(&rw_fifo, sg, ARRAY_SIZE(sg), min_t(size_t, count, UINT_MAX));
+    for (i = 0; i < nents; i++) {
+        size_t n = copy_from_iter(sg_virt(&sg[i]), sg[i].length, from);
+
+        copied += n;
+        if (n < sg[i].length) {
+            break;
+        }
+    }
+    kfifo_dma_in_finish(&rw_fifo, copied);
+    mutex_unlock(&rw_lock);
+    if (!copied) {
+        return rw_account(op, start, -EFAULT);  // 复制失败
+    }
+
+    wake_up_interruptible(&rw_readq);  // 有新数据，唤醒读者
+    return rw_account(op, start, copied);  // 返回写入的字节数
+}
+
+// poll/select/epoll 支持：有数据可读报告 POLLIN，有空间可写报告 POLLOUT
+static __poll_t rw_poll(struct file *filp, poll_table *wait) {
+    __poll_t mask = 0;
+
+    poll_wait(filp, &rw_readq, wait);
+    poll_wait(filp, &rw_writeq, wait);
+
+    if (!kfifo_is_empty(&rw_fifo)) {
+        mask |= EPOLLIN | EPOLLRDNORM;
+    }
+    if (!kfifo_is_full(&rw_fifo)) {
+        mask |= EPOLLOUT | EPOLLWRNORM;
+    }
+    return mask;
+}
+
+// FIFO 文件操作
+static const struct file_operations rw_fifo_fops = {
+        .owner = THIS_MODULE,
+        .open = rw_fifo_open,
+        .read_iter = rw_read_iter,
+        .write_iter = rw_write_iter,
+        .poll = rw_poll,
+        .splice_read = RW_SPLICE_READ,
+        .splice_write = iter_file_splice_write,
+};
+
+/* ---------------- 私有缓冲区模式 ---------------- */
+
+// 每个打开的文件独立拥有的状态，同一个 fd 可能被多个线程共享，因此仍需要锁
+struct rw_priv {
+    struct mutex lock;
+    size_t data_size;          // 当前数据长度
+    char buf[BUFFER_SIZE];
+};
+
+static int rw_priv_open(struct inode *inode, struct file *filp) {
+    struct rw_priv *priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+
+    if (!priv) {
+        return -ENOMEM;
+    }
+    mutex_init(&priv->lock);
+    priv->data_size = scnprintf(priv->buf, BUFFER_SIZE, "Hello from Kernel!");
+    filp->private_data = priv;
+    return 0;
+}
+
+static int rw_priv_release(struct inode *inode, struct file *filp) {
+    kfree(filp->private_data);
+    return 0;
+}
+
+static ssize_t rw_priv_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+    const int op = RW_LAT_OP(RW_MINOR_PRIV, 0);
+    u64 start = rw_begin(op, iov_iter_count(to), iocb->ki_pos);
+    struct rw_priv *priv = iocb->ki_filp->private_data;
+    size_t count, copied;
+    ssize_t ret;
+
+    ret = rw_mutex_lock(&priv->lock, iocb);
+    if (ret) {
+        return rw_account(op, start, ret);
+    }
+    if (iocb->ki_pos >= priv->data_size) {
+        ret = 0;  // 没有更多数据可读
+    } else {
+        count = min_t(size_t, iov_iter_count(to), priv->data_size - iocb->ki_pos);
+        copied = copy_to_iter(priv->buf + iocb->ki_pos, count, to);
+        iocb->ki_pos += copied;
+        ret = copied ? copied : -EFAULT;
+    }
+    mutex_unlock(&priv->lock);
+    return rw_account(op, start, ret);
+}
+
+// 与原始语义一致：每次写入从头覆盖缓冲区，分散的 iovec 会被依次拼接
+static ssize_t rw_priv_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+    const int op = RW_LAT_OP(RW_MINOR_PRIV, 1);
+    u64 start = rw_begin(op, iov_iter_count(from), iocb->ki_pos);
+    struct rw_priv *priv = iocb->ki_filp->private_data;
+    size_t count = min_t(size_t, iov_iter_count(from), BUFFER_SIZE), copied;
+    ssize_t ret;
+
+    ret = rw_mutex_lock(&priv->lock, iocb);
+    if (ret) {
+        return rw_account(op, start, ret);
+    }
+    copied = copy_from_iter(priv->buf, count, from);
+    if (!copied && count) {
+        ret = -EFAULT;
+    } else {
+        priv->data_size = copied;
+        ret = copied;
+    }
+    mutex_unlock(&priv->lock);
+    return rw_account(op, start, ret);
+}
+
+static const struct file_operations rw_priv_fops = {
+        .owner = THIS_MODULE,
+        .open = rw_priv_open,
+        .release = rw_priv_release,
+        .read_iter = rw_priv_read_iter,
+        .write_iter = rw_priv_write_iter,
+        .llseek = default_llseek,
+        .splice_read = RW_SPLICE_READ,
+        .splice_write = iter_file_splice_write,
+};
+
+/* ---------------- RCU 共享快照模式 ---------------- */
+
+/*
+ * 快照一经发布就不再修改。写者构造新快照后用 rcu_assign_pointer 替换旧指针，
+ * 读者在 rcu_read_lock 下直接读取，不接触任何锁或共享写入的 cache line。
+ * ref 只在读者的慢路径（拷贝时发生缺页）中使用，用来让快照在 RCU 临界区之外继续存活。
+ */
+struct rw_snap {
+    struct rcu_head rcu;
+    refcount_t ref;            // 发布本身持有一个引用
+    size_t size;
+    char data[];
+};
+
+static struct rw_snap __rcu *rw_snapshot;
+static DEFINE_MUTEX(rw_snap_lock);  // 仅用于串行化写者
+
+static struct rw_snap *rw_snap_alloc(size_t size, gfp_t gfp) {
+    struct rw_snap *snap = kmalloc(struct_size(snap, data, size), gfp);
+
+    if (snap) {
+        refcount_set(&snap->ref, 1);
+        snap->size = size;
+    }
+    return snap;
+}
+
+static void rw_snap_put(struct rw_snap *snap) {
+    if (snap && refcount_dec_and_test(&snap->ref)) {
+        kfree_rcu(snap, rcu);  // 等待所有 RCU 读者退出后再释放
+    }
+}
+
+// 发布新快照，旧快照在宽限期后释放
+static int rw_snap_publish(struct rw_snap *snap, struct kiocb *iocb) {
+    struct rw_snap *old;
+    int ret;
+
+    ret = rw_mutex_lock(&rw_snap_lock, iocb);
+    if (ret) {
+        return ret;
+    }
+    old = rcu_replace_pointer(rw_snapshot, snap, lockdep_is_held(&rw_snap_lock));
+    mutex_unlock(&rw_snap_lock);
+    rw_snap_put(old);
+    return 0;
+}
+
+/*
+ * 快路径：在 RCU 临界区内关闭缺页直接拷贝，绝大多数读取在这里完成。
+ * 慢路径：用户缓冲区未驻留导致一个字节也没拷贝成功时，取一个引用离开 RCU 临界区，
+ * 再以可睡眠的方式拷贝；已经拷贝了一部分时直接返回部分读取。
+ */
+static ssize_t rw_snap_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+    const int op = RW_LAT_OP(RW_MINOR_SNAP, 0);
+    u64 start = rw_begin(op, iov_iter_count(to), iocb->ki_pos);
+    loff_t pos = iocb->ki_pos;
+    struct rw_snap *snap;
+    size_t count, copied;
+
+retry:
+    rcu_read_lock();
+    snap = rcu_dereference(rw_snapshot);
+    if (!snap || pos >= snap->size) {
+        rcu_read_unlock();
+        return rw_account(op, start, 0);
+    }
+    count = min_t(size_t, iov_iter_count(to), snap->size - pos);
+
+    pagefault_disable();
+    copied = copy_to_iter(snap->data + pos, count, to);
+    pagefault_enable();
+    if (copied || (iocb->ki_flags & IOCB_NOWAIT)) {
+        rcu_read_unlock();
+        iocb->ki_pos = pos + copied;
+        return rw_account(op, start, copied ? copied : -EAGAIN);
+    }
+
+    if (!refcount_inc_not_zero(&snap->ref)) {
+        rcu_read_unlock();
+        goto retry;  // 快照恰好被替换并释放，读取新版本
+    }
+    rcu_read_unlock();
+
+    copied = copy_to_iter(snap->data + pos, count, to);
+    rw_snap_put(snap);
+    if (!copied) {
+        return rw_account(op, start, -EFAULT);
+    }
+    iocb->ki_pos = pos + copied;
+    return rw_account(op, start, copied);
+}
+
+// 写入：在锁外把所有 iovec 拼成一个新快照，然后一次性替换
+static ssize_t rw_snap_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+    const int op = RW_LAT_OP(RW_MINOR_SNAP, 1);
+    u64 start = rw_begin(op, iov_iter_count(from), iocb->ki_pos);
+    size_t count = min_t(size_t, iov_iter_count(from), BUFFER_SIZE);
+    struct rw_snap *snap;
+    int ret;
+
+    snap = rw_snap_alloc(count, (iocb->ki_flags & IOCB_NOWAIT) ? GFP_NOWAIT : GFP_KERNEL);
+    if (!snap) {
+        return rw_account(op, start, (iocb->ki_flags & IOCB_NOWAIT) ? -EAGAIN : -ENOMEM);
+    }
+    if (copy_from_iter(snap->data, count, from) != count) {
+        kfree(snap);
+        return rw_account(op, start, -EFAULT);
+    }
+
+    ret = rw_snap_publish(snap, iocb);
+    if (ret) {
+        kfree(snap);
+        return rw_account(op, start, ret);
+    }
+    return rw_account(op, start, count);
+}
+
+static const struct file_operations rw_snap_fops = {
+        .owner = THIS_MODULE,
+        .read_iter = rw_snap_read_iter,
+        .write_iter = rw_snap_write_iter,
+        .llseek = default_llseek,
+        .splice_read = RW_SPLICE_READ,
+        .splice_write = iter_file_splice_write,
+};
+
+/* ---------------- 稀疏页存储模式 ---------------- */
+
+// 存储的最大字节数，可以在运行时通过 /sys/module/read_write_driver/parameters/store_max_size 调整
+static unsigned long long store_max_size = 1ULL << 30;
+module_param(store_max_size, ullong, 0644);
+MODULE_PARM_DESC(store_max_size, "Maximum size in bytes of /dev/readwrite_demo_store");
+
+/*
+ * 存储按页组织在 xarray 中，页号 = 偏移 >> PAGE_SHIFT，只有被写过的页才会分配；
+ * 空洞读出为 0。读者共享、写者独占 store_rwsem，store_size 是写过的最大偏移。
+ */
+static DEFINE_XARRAY(store_pages);
+static DECLARE_RWSEM(store_rwsem);
+static loff_t store_size;
+static unsigned long store_nr_pages;  // 已分配的页数
+
+static int rw_store_lock(struct kiocb *iocb, bool write) {
+    if (iocb->ki_flags & IOCB_NOWAIT) {
+        if (write ? down_write_trylock(&store_rwsem) : down_read_trylock(&store_rwsem)) {
+            return 0;
+        }
+        return -EAGAIN;
+    }
+    if (write) {
+        return down_write_killable(&store_rwsem);
+    }
+    return down_read_killable(&store_rwsem);
+}
 
-// 设备读取操作：用户空间调用 read() 读取数据
-static ssize_t rw_read(struct file *filp, char __user *user_buf, size_t count, loff_t *pos) {
-    if (*pos >= data_size) {
-        return 0;  // 没有更多数据可读
+static ssize_t rw_store_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+    const int op = RW_LAT_OP(RW_MINOR_STORE, 0);
+    u64 start = rw_begin(op, iov_iter_count(to), iocb->ki_pos);
+    loff_t pos = iocb->ki_pos;
+    size_t done = 0;
+    int ret;
+
+    ret = rw_store_lock(iocb, false);
+    if (ret) {
+        return rw_account(op, start, ret);
+    }
+    while (iov_iter_count(to) && pos < store_size) {
+        size_t off = offset_in_page(pos);
+        size_t n = min3((size_t)(PAGE_SIZE - off), iov_iter_count(to), (size_t)(store_size - pos));
+        struct page *page = xa_load(&store_pages, pos >> PAGE_SHIFT);
+        size_t copied = page ? copy_page_to_iter(page, off, n, to) : iov_iter_zero(n, to);
+
+        done += copied;
+        pos += copied;
+        if (copied < n) {
+            break;  // 用户缓冲区缺页失败
+        }
+    }
+    up_read(&store_rwsem);
+
+    if (!done && iov_iter_count(to) && pos < store_size) {
+        return rw_account(op, start, -EFAULT);
+    }
+    iocb->ki_pos = pos;
+    return rw_account(op, start, done);
+}
+
+static ssize_t rw_store_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+    const int op = RW_LAT_OP(RW_MINOR_STORE, 1);
+    u64 start = rw_begin(op, iov_iter_count(from), iocb->ki_pos);
+    size_t count = iov_iter_count(from), done = 0;
+    // 参数可以在运行时修改，只读取一次，检查与截断使用同一个值，避免 max_size - pos 下溢
+    u64 max_size = READ_ONCE(store_max_size);
+    loff_t pos;
+    int ret;
+
+    ret = rw_store_lock(iocb, true);
+    if (ret) {
+        return rw_account(op, start, ret);
+    }
+
+    pos = (iocb->ki_flags & IOCB_APPEND) ? store_size : iocb->ki_pos;
+    if (count && pos >= max_size) {
+        up_write(&store_rwsem);
+        return rw_account(op, start, -EFBIG);
+    }
+    count = min_t(u64, count, max_size - pos);
+
+    while (done < count) {
+        size_t off = offset_in_page(pos);
+        size_t n = min_t(size_t, PAGE_SIZE - off, count - done);
+        struct page *page = xa_load(&store_pages, pos >> PAGE_SHIFT);
+        size_t copied;
+
+        if (!page) {
+            // 首次写入该页时才分配
+            gfp_t gfp = (iocb->ki_flags & IOCB_NOWAIT) ? GFP_NOWAIT : GFP_KERNEL;
+
+            page = alloc_page(gfp | __GFP_ZERO);
+            if (!page) {
+                ret = (iocb->ki_flags & IOCB_NOWAIT) ? -EAGAIN : -ENOMEM;
+                break;
+            }
+            ret = xa_err(xa_store(&store_pages, pos >> PAGE_SHIFT, page, gfp));
+            if (ret) {
+                __free_page(page);
+                break;
+            }
+            store_nr_pages++;
+        }
+
+        copied = copy_page_from_iter(page, off, n, from);
+        done += copied;
+        pos += copied;
+        if (copied < n) {
+            ret = -EFAULT;
+            break;
+        }
+    }
+    if (pos > store_size) {
+        store_size = pos;
+    }
+    up_write(&store_rwsem);
+
+    if (!done) {
+        return rw_account(op, start, ret);
+    }
+    iocb->ki_pos = pos;
+    return rw_account(op, start, done);
+}
+
+// 支持 SEEK_SET/SEEK_CUR/SEEK_END，SEEK_END 以当前写过的最大偏移为文件末尾
+static loff_t rw_store_llseek(struct file *filp, loff_t offset, int whence) {
+    return generic_file_llseek_size(filp, offset, whence, READ_ONCE(store_max_size), READ_ONCE(store_size));
+}
+
+static void rw_store_spd_release(struct splice_pipe_desc *spd, unsigned int i) {
+    put_page(spd->pages[i]);
+}
+
+/*
+ * 零拷贝 splice：把存储页本身（空洞用零页）以引用的方式放入管道，
+ * 之后 splice 到文件或 socket 时只转交页引用，不拷贝数据。
+ * 与页缓存的 splice 一样，管道中的页在被消费前如果再次被写入，读者会看到新内容。
+ * 使用内核内置的 nosteal_pipe_buf_ops，管道中残留的页不会引用本模块的代码。
+ */
+static ssize_t rw_store_splice_read(struct file *in, loff_t *ppos, struct pipe_inode_info *pipe,
+                                    size_t len, unsigned int flags) {
+    const int op = RW_LAT_OP(RW_MINOR_STORE, 0);
+    u64 start = rw_begin(op, len, *ppos);
+    struct page *pages[PIPE_DEF_BUFFERS];
+    struct partial_page partial[PIPE_DEF_BUFFERS];
+    struct splice_pipe_desc spd = {
+            .pages = pages,
+            .partial = partial,
+            .nr_pages_max = PIPE_DEF_BUFFERS,
+            .ops = &nosteal_pipe_buf_ops,
+            .spd_release = rw_store_spd_release,
+    };
+    loff_t pos = *ppos;
+    ssize_t ret;
+
+    down_read(&store_rwsem);
+    while (len && pos < store_size && spd.nr_pages < PIPE_DEF_BUFFERS) {
+        size_t off = offset_in_page(pos);
+        size_t n = min3((size_t)(PAGE_SIZE - off), len, (size_t)(store_size - pos));
+        struct page *page = xa_load(&store_pages, pos >> PAGE_SHIFT);
+
+        if (!page) {
+            page = ZERO_PAGE(0);
+        }
+        get_page(page);  // 由管道在消费后释放
+        pages[spd.nr_pages] = page;
+        partial[spd.nr_pages].offset = off;
+        partial[spd.nr_pages].len = n;
+        spd.nr_pages++;
+        pos += n;
+        len -= n;
     }
+    up_read(&store_rwsem);
 
-    if (count > data_size - *pos) {
-        count = data_size - *pos;  // 限制读取数据大小
+    if (!spd.nr_pages) {
+        return rw_account(op, start, 0);
     }
+    ret = splice_to_pipe(pipe, &spd);
+    if (ret > 0) {
+        *ppos += ret;
+    }
+    return rw_account(op, start, ret);
+}
 
-    if (copy_to_user(user_buf, kernel_buffer + *pos, count) != 0) {
-        return -EFAULT;  // 复制失败
+/*
+ * 固定缓冲区，接口见 readwrite_demo.h。登记时固定用户页并建立 bio_vec 数组；
+ * 读写时用 ITER_BVEC 类型的 iov_iter 直接调用 rw_store_read_iter / rw_store_write_iter，
+ * 数据由 copy_page_to_iter / copy_page_from_iter 在两组内核可直接访问的页之间拷贝，
+ * 与 read()/write() 共用同一套存储逻辑、统计与跟踪点。
+ * 6.1 之前 iov_iter 的方向用 READ / WRITE 表示。
+ */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,1,0)
+#define ITER_DEST READ
+#define ITER_SOURCE WRITE
+#endif
+
+// 所有打开的文件固定的内存总量上限（MB）
+static unsigned int pin_max_mb = 256;
+module_param(pin_max_mb, uint, 0644);
+MODULE_PARM_DESC(pin_max_mb, "Maximum MB of user memory pinned by RW_IOC_REGISTER_BUF across all files");
+
+static atomic_long_t store_pinned_pages;  // 当前固定的页数
+
+struct rw_fixed_buf {
+    struct page **pages;     // pin_user_pages_fast 返回的页
+    struct bio_vec *bvecs;   // 每页一项，首页从用户地址的页内偏移开始
+    unsigned long nr_pages;
+    size_t len;
+};
+
+// 存储设备每个打开的文件的状态
+struct rw_store_file {
+    struct rw_semaphore lock;  // 固定缓冲区读写时共享，登记/解除时独占
+    struct rw_fixed_buf *bufs[RW_MAX_FIXED_BUFS];
+};
+
+static void rw_fixed_buf_free(struct rw_fixed_buf *buf) {
+    // 内核可能写过这些页，解除固定时标记为脏页
+    unpin_user_pages_dirty_lock(buf->pages, buf->nr_pages, true);
+    atomic_long_sub(buf->nr_pages, &store_pinned_pages);
+    kvfree(buf->bvecs);
+    kvfree(buf->pages);
+    kfree(buf);
+}
+
+static int rw_store_open(struct inode *inode, struct file *filp) {
+    struct rw_store_file *sf = kzalloc(sizeof(*sf), GFP_KERNEL);
+
+    if (!sf) {
+        return -ENOMEM;
     }
+    init_rwsem(&sf->lock);
+    filp->private_data = sf;
+    return 0;
+}
+
+// 关闭文件时解除所有仍登记着的缓冲区
+static int rw_store_release(struct inode *inode, struct file *filp) {
+    struct rw_store_file *sf = filp->private_data;
+    int i;
 
-    *pos += count;
-    return count;  // 返回实际读取的字节数
+    for (i = 0; i < RW_MAX_FIXED_BUFS; i++) {
+        if (sf->bufs[i]) {
+            rw_fixed_buf_free(sf->bufs[i]);
+        }
+    }
+    kfree(sf);
+    return 0;
 }
 
-// 设备写入操作：用户空间调用 write() 传输数据到内核
-static ssize_t rw_write(struct file *filp, const char __user *user_buf, size_t count, loff_t *pos) {
-    if (count > BUFFER_SIZE) {
-        count = BUFFER_SIZE;  // 限制最大写入数据
+// 固定 [addr, addr + len) 覆盖的所有用户页并建立 bio_vec 数组
+static struct rw_fixed_buf *rw_fixed_buf_pin(u64 addr, u64 len) {
+    unsigned long limit = (unsigned long)READ_ONCE(pin_max_mb) << (20 - PAGE_SHIFT);
+    size_t off = offset_in_page(addr), left = len;
+    struct rw_fixed_buf *buf;
+    unsigned long i;
+    long pinned;
+    int ret;
+
+    if (!len || addr + len < addr || DIV_ROUND_UP(off + len, PAGE_SIZE) > min_t(unsigned long, limit, INT_MAX)) {
+        return ERR_PTR(-EINVAL);
+    }
+    buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+    if (!buf) {
+        return ERR_PTR(-ENOMEM);
+    }
+    buf->len = len;
+    buf->nr_pages = DIV_ROUND_UP(off + len, PAGE_SIZE);
+    if (atomic_long_add_return(buf->nr_pages, &store_pinned_pages) > limit) {
+        ret = -ENOMEM;
+        goto err_account;
+    }
+
+    buf->pages = kvmalloc_array(buf->nr_pages, sizeof(*buf->pages), GFP_KERNEL);
+    buf->bvecs = kvmalloc_array(buf->nr_pages, sizeof(*buf->bvecs), GFP_KERNEL);
+    if (!buf->pages || !buf->bvecs) {
+        ret = -ENOMEM;
+        goto err_alloc;
+    }
+
+    // FOLL_LONGTERM：页会被长期持有，内核先把它们迁出 CMA/ZONE_MOVABLE，且拒绝不适合长期固定的映射
+    pinned = pin_user_pages_fast(addr & PAGE_MASK, buf->nr_pages, FOLL_WRITE | FOLL_LONGTERM, buf->pages);
+    if (pinned != buf->nr_pages) {
+        if (pinned > 0) {
+            unpin_user_pages(buf->pages, pinned);
+        }
+        ret = pinned < 0 ? pinned : -EFAULT;
+        goto err_alloc;
     }
 
-    if (copy_from_user(kernel_buffer, user_buf, count) != 0) {
-        return -EFAULT;  // 复制失败
+    for (i = 0; i < buf->nr_pages; i++) {
+        buf->bvecs[i].bv_page = buf->pages[i];
+        buf->bvecs[i].bv_offset = i ? 0 : off;
+        buf->bvecs[i].bv_len = min_t(size_t, PAGE_SIZE - buf->bvecs[i].bv_offset, left);
+        left -= buf->bvecs[i].bv_len;
     }
+    return buf;
 
-    data_size = count;
-    return count;  // 返回写入的字节数
+err_alloc:
+    kvfree(buf->bvecs);
+    kvfree(buf->pages);
+err_account:
+    atomic_long_sub(buf->nr_pages, &store_pinned_pages);
+    kfree(buf);
+    return ERR_PTR(ret);
 }
 
-// 设备文件操作
-static struct file_operations fops = {
+static long rw_fixed_register(struct rw_store_file *sf, struct rw_fixed_reg __user *ureg) {
+    struct rw_fixed_reg reg;
+    struct rw_fixed_buf *buf;
+    u32 index;
+
+    if (copy_from_user(&reg, ureg, sizeof(reg))) {
+        return -EFAULT;
+    }
+    if (reg.reserved) {
+        return -EINVAL;
+    }
+    buf = rw_fixed_buf_pin(reg.addr, reg.len);
+    if (IS_ERR(buf)) {
+        return PTR_ERR(buf);
+    }
+
+    down_write(&sf->lock);
+    for (index = 0; index < RW_MAX_FIXED_BUFS && sf->bufs[index]; index++) {
+    }
+    if (index < RW_MAX_FIXED_BUFS) {
+        sf->bufs[index] = buf;
+    }
+    up_write(&sf->lock);
+
+    if (index == RW_MAX_FIXED_BUFS) {
+        rw_fixed_buf_free(buf);
+        return -EBUSY;  // 没有空闲的编号
+    }
+    if (put_user(index, &ureg->index)) {
+        return -EFAULT;  // 缓冲区已经登记，关闭文件时会被释放
+    }
+    return 0;
+}
+
+static long rw_fixed_unregister(struct rw_store_file *sf, u32 __user *uindex) {
+    struct rw_fixed_buf *buf = NULL;
+    u32 index;
+
+    if (get_user(index, uindex)) {
+        return -EFAULT;
+    }
+    if (index >= RW_MAX_FIXED_BUFS) {
+        return -EINVAL;
+    }
+    index = array_index_nospec(index, RW_MAX_FIXED_BUFS);
+
+    // 独占锁等待进行中的读写结束
+    down_write(&sf->lock);
+    swap(buf, sf->bufs[index]);
+    up_write(&sf->lock);
+
+    if (!buf) {
+        return -ENOENT;
+    }
+    rw_fixed_buf_free(buf);
+    return 0;
+}
+
+// 在存储与固定缓冲区之间传输，返回字节数
+static long rw_fixed_io(struct file *filp, struct rw_fixed_io __user *uio, bool write) {
+    struct rw_store_file *sf = filp->private_data;
+    struct rw_fixed_buf *buf;
+    struct rw_fixed_io io;
+    struct iov_iter iter;
+    struct kiocb kiocb;
+    long ret;
+
+    if (copy_from_user(&io, uio, sizeof(io))) {
+        return -EFAULT;
+    }
+    if (io.index >= RW_MAX_FIXED_BUFS || io.reserved || io.pos > MAX_LFS_FILESIZE) {
+        return -EINVAL;
+    }
+
+    down_read(&sf->lock);
+    buf = sf->bufs[array_index_nospec(io.index, RW_MAX_FIXED_BUFS)];
+    if (!buf) {
+        ret = -ENOENT;
+    } else if (io.buf_offset > buf->len || io.len > buf->len - io.buf_offset) {
+        ret = -EINVAL;
+    } else {
+        iov_iter_bvec(&iter, write ? ITER_SOURCE : ITER_DEST, buf->bvecs, buf->nr_pages, buf->len);
+        iov_iter_advance(&iter, io.buf_offset);
+        iov_iter_truncate(&iter, io.len);
+        init_sync_kiocb(&kiocb, filp);
+        kiocb.ki_pos = io.pos;
+        ret = write ? rw_store_write_iter(&kiocb, &iter) : rw_store_read_iter(&kiocb, &iter);
+    }
+    up_read(&sf->lock);
+    return ret;
+}
+
+static long rw_store_ioctl(struct file *filp, unsigned int cmd, unsigned long arg) {
+    struct rw_store_file *sf = filp->private_data;
+
+    switch (cmd) {
+        case RW_IOC_REGISTER_BUF:
+            return rw_fixed_register(sf, (struct rw_fixed_reg __user *)arg);
+        case RW_IOC_UNREGISTER_BUF:
+            return rw_fixed_unregister(sf, (u32 __user *)arg);
+        case RW_IOC_READ_FIXED:
+            return rw_fixed_io(filp, (struct rw_fixed_io __user *)arg, false);
+        case RW_IOC_WRITE_FIXED:
+            return rw_fixed_io(filp, (struct rw_fixed_io __user *)arg, true);
+        default:
+            return -ENOTTY;
+    }
+}
+
+static const struct file_operations rw_store_fops = {
         .owner = THIS_MODULE,
-        .read = rw_read,
-        .write = rw_write,
+        .open = rw_store_open,
+        .release = rw_store_release,
+        .unlocked_ioctl = rw_store_ioctl,
+        .read_iter = rw_store_read_iter,
+        .write_iter = rw_store_write_iter,
+        .llseek = rw_store_llseek,
+        .splice_read = rw_store_splice_read,
+        .splice_write = iter_file_splice_write,
+};
+
+static void rw_store_free(void) {
+    struct page *page;
+    unsigned long idx;
+
+    xa_for_each(&store_pages, idx, page) {
+        put_page(page);
+    }
+    xa_destroy(&store_pages);
+}
+
+/* ---------------- 次设备号分发 ---------------- */
+
+static const struct {
+    const char *name;
+    const struct file_operations *fops;
+} rw_devs[RW_NR_DEVS] = {
+    [RW_MINOR_FIFO] = { DEVICE_NAME,           &rw_fifo_fops },
+    [RW_MINOR_PRIV] = { DEVICE_NAME "_priv",   &rw_priv_fops },
+    [RW_MINOR_SNAP] = { DEVICE_NAME "_snap",   &rw_snap_fops },
+    [RW_MINOR_STORE] = { DEVICE_NAME "_store", &rw_store_fops },
 };
 
+// 根据次设备号替换为对应模式的文件操作，再调用其 open
+static int rw_open(struct inode *inode, struct file *filp) {
+    unsigned int minor = iminor(inode);
+
+    if (minor >= RW_NR_DEVS) {
+        return -ENXIO;
+    }
+    filp->f_op = rw_devs[minor].fops;  // 同一模块内的 fops，无需调整模块引用计数
+    filp->f_mode |= FMODE_NOWAIT;      // 所有模式都遵守 IOCB_NOWAIT，io_uring 可以内联尝试而不必交给 io-wq
+    if (filp->f_op->open) {
+        return filp->f_op->open(inode, filp);
+    }
+    return 0;
+}
+
+// 设备文件操作：只负责分发
+static const struct file_operations fops = {
+        .owner = THIS_MODULE,
+        .open = rw_open,
+};
+
+// 销毁前 n 个设备节点
+static void rw_destroy_devices(int n) {
+    while (n-- > 0) {
+        device_destroy(rw_class, MKDEV(MAJOR(dev_num), n));
+    }
+}
+
 // 初始化内核模块
 static int __init rw_driver_init(void) {
-    int ret;
+    struct rw_snap *snap;
+    struct device *dev;
+    int ret, i;
+
+    // 分配 FIFO
+    ret = kfifo_alloc(&rw_fifo, fifo_size, GFP_KERNEL);
+    if (ret) {
+        return ret;
+    }
+    // 内核初始化数据
+    kfifo_in(&rw_fifo, "Hello from Kernel!", strlen("Hello from Kernel!"));
+
+    // 发布初始快照
+    snap = rw_snap_alloc(strlen("Hello from Kernel!"), GFP_KERNEL);
+    if (!snap) {
+        kfifo_free(&rw_fifo);
+        return -ENOMEM;
+    }
+    memcpy(snap->data, "Hello from Kernel!", snap->size);
+    rcu_assign_pointer(rw_snapshot, snap);
 
     // 申请设备号
-    ret = alloc_chrdev_region(&dev_num, 0, 1, DEVICE_NAME);
+    ret = alloc_chrdev_region(&dev_num, 0, RW_NR_DEVS, DEVICE_NAME);
     if (ret < 0) {
         printk(KERN_ERR "Failed to allocate device number\n");
-        return ret;
+        goto err_buf;
     }
 
     // 初始化字符设备
     cdev_init(&rw_cdev, &fops);
-    ret = cdev_add(&rw_cdev, dev_num, 1);
+    ret = cdev_add(&rw_cdev, dev_num, RW_NR_DEVS);
     if (ret < 0) {
-        unregister_chrdev_region(dev_num, 1);
         printk(KERN_ERR "Failed to add cdev\n");
-        return ret;
+        goto err_region;
     }
 
     // 创建设备类
     rw_class = class_create(CLASS_NAME);
     if (IS_ERR(rw_class)) {
-        cdev_del(&rw_cdev);
-        unregister_chrdev_region(dev_num, 1);
-        return PTR_ERR(rw_class);
-    }
-
-    // 创建设备节点 /dev/readwrite_demo
-    rw_device = device_create(rw_class, NULL, dev_num, NULL, DEVICE_NAME);
-    if (IS_ERR(rw_device)) {
-        class_destroy(rw_class);
-        cdev_del(&rw_cdev);
-        unregister_chrdev_region(dev_num, 1);
-        return PTR_ERR(rw_device);
-    }
-
-    // 分配内核缓冲区
-    kernel_buffer = kmalloc(BUFFER_SIZE, GFP_KERNEL);
-    if (!kernel_buffer) {
-        device_destroy(rw_class, dev_num);
-        class_destroy(rw_class);
-        cdev_del(&rw_cdev);
-        unregister_chrdev_region(dev_num, 1);
-        return -ENOMEM;
+        ret = PTR_ERR(rw_class);
+        goto err_cdev;
     }
 
-    // 内核初始化数据
-    snprintf(kernel_buffer, BUFFER_SIZE, "Hello from Kernel!");
-    data_size = strlen(kernel_buffer);
+    // 创建设备节点 /dev/readwrite_demo*
+    for (i = 0; i < RW_NR_DEVS; i++) {
+        dev = device_create(rw_class, NULL, MKDEV(MAJOR(dev_num), i), NULL, rw_devs[i].name);
+        if (IS_ERR(dev)) {
+            ret = PTR_ERR(dev);
+            rw_destroy_devices(i);
+            goto err_class;
+        }
+    }
+
+    // 观测失败不影响驱动本身，rw_lat 为 NULL 时不记录
+    rw_lat = u2k_lat_register("readwrite", rw_lat_names, RW_LAT_NR);
+    if (IS_ERR(rw_lat)) {
+        printk(KERN_WARNING "Failed to register /proc/u2k/readwrite\n");
+        rw_lat = NULL;
+    }
 
     printk(KERN_INFO "readwrite_demo driver initialized\n");
     return 0;
+
+err_class:
+    class_destroy(rw_class);
+err_cdev:
+    cdev_del(&rw_cdev);
+err_region:
+    unregister_chrdev_region(dev_num, RW_NR_DEVS);
+err_buf:
+    kfree(rcu_dereference_protected(rw_snapshot, 1));
+    kfifo_free(&rw_fifo);
+    return ret;
 }
 
 // 卸载内核模块
 static void __exit rw_driver_exit(void) {
-    kfree(kernel_buffer);
-    device_destroy(rw_class, dev_num);
+    u64 stats[RW_STAT_NR];
+
+    rw_destroy_devices(RW_NR_DEVS);
+    u2k_lat_unregister(rw_lat);
     class_destroy(rw_class);
     cdev_del(&rw_cdev);
-    unregister_chrdev_region(dev_num, 1);
+    unregister_chrdev_region(dev_num, RW_NR_DEVS);
+    rw_snap_put(rcu_dereference_protected(rw_snapshot, 1));
+    rcu_barrier();  // 等待 kfree_rcu 完成
+    printk(KERN_INFO "readwrite_demo: store used %lu pages for %lld bytes\n", store_nr_pages, store_size);
+    u2k_stats_sum(&rw_stats, stats, RW_STAT_NR);
+    printk(KERN_INFO "readwrite_demo: %llu reads (%llu bytes), %llu writes (%llu bytes)\n",
+           stats[RW_STAT_READ], stats[RW_STAT_READ_BYTES], stats[RW_STAT_WRITE], stats[RW_STAT_WRITE_BYTES]);
+    rw_store_free();
+    kfifo_free(&rw_fifo);
     printk(KERN_INFO "readwrite_demo driver removed\n");
 }
 
@@ -126,4 +1051,4 @@ module_exit(rw_driver_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Ruoniao");
-MODULE_DESCRIPTION("Read/Write Kernel Driver with Initial Data");
\ No newline at end of file
+MODULE_DESCRIPTION("Read/Write Kernel Driver with Blocking FIFO Semantics");
\ No newline at end of file
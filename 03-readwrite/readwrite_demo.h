@@ -0,0 +1,42 @@
+#ifndef READWRITE_DEMO_H
+#define READWRITE_DEMO_H
+
+/*
+ * readwrite_demo 内核模块与用户态程序共享的定义。
+ *
+ * /dev/readwrite_demo_store 的固定缓冲区（与 io_uring 的 registered buffers 思路相同）：
+ * RW_IOC_REGISTER_BUF 把一段用户内存登记到打开的文件上，内核用 pin_user_pages 一次性固定这些页，
+ * 之后 RW_IOC_READ_FIXED / RW_IOC_WRITE_FIXED 在存储页与这些页之间直接拷贝：
+ * 不再每次检查用户地址、遍历页表、处理缺页，也不经过 copy_to_user / copy_from_user。
+ * RW_IOC_UNREGISTER_BUF 或关闭文件时解除固定。固定的页不会被换出，总量受加载参数 pin_max_mb 限制。
+ *
+ * READ_FIXED / WRITE_FIXED 的语义与 pread / pwrite 相同（不移动文件偏移），返回传输的字节数。
+ */
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define RW_MAX_FIXED_BUFS 16  // 每个打开的文件最多登记的缓冲区个数
+
+// RW_IOC_REGISTER_BUF 的参数
+struct rw_fixed_reg {
+    __u64 addr;      // 用户缓冲区地址，不要求页对齐
+    __u64 len;       // 长度（字节）
+    __u32 index;     // 输出：缓冲区编号，0 ~ RW_MAX_FIXED_BUFS-1
+    __u32 reserved;
+};
+
+// RW_IOC_READ_FIXED / RW_IOC_WRITE_FIXED 的参数
+struct rw_fixed_io {
+    __u32 index;       // 缓冲区编号
+    __u32 reserved;
+    __u64 buf_offset;  // 缓冲区内的起始偏移
+    __u64 pos;         // 存储中的偏移
+    __u64 len;         // 字节数，buf_offset + len 不超过缓冲区长度
+};
+
+#define RW_IOC_REGISTER_BUF   _IOWR('r', 1, struct rw_fixed_reg) // 固定一段用户内存
+#define RW_IOC_UNREGISTER_BUF _IOW('r', 2, __u32)                // 按编号解除固定
+#define RW_IOC_READ_FIXED     _IOW('r', 3, struct rw_fixed_io)   // 存储 -> 固定缓冲区
+#define RW_IOC_WRITE_FIXED    _IOW('r', 4, struct rw_fixed_io)   // 固定缓冲区 -> 存储
+
+#endif // READWRITE_DEMO_H
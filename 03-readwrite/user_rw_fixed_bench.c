@@ -0,0 +1,175 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "readwrite_demo.h"
+
+/*
+ * pread/pwrite 与固定缓冲区（RW_IOC_READ_FIXED / RW_IOC_WRITE_FIXED）的对比：
+ *   先做功能测试（非页对齐的缓冲区偏移、错误编号、解除登记后不可用），
+ *   再把存储预先写满 16MB，在 64KB 到 16MB 的单次传输大小下分别报告两种方式的吞吐。
+ * 两种方式都只有一次存储页到用户页的拷贝；差别在于固定缓冲区省去了每次调用的
+ * 地址检查、页表遍历和 SMAP 开关，传输越大、页数越多越明显。
+ */
+
+#define STORE_PATH "/dev/readwrite_demo_store"
+#define MAX_CHUNK (16UL << 20)
+#define TOTAL_BYTES (1UL << 30)  // 每种配置传输的总字节数
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int register_buf(int fd, void *addr, size_t len) {
+    struct rw_fixed_reg reg = { .addr = (uintptr_t)addr, .len = len };
+
+    if (ioctl(fd, RW_IOC_REGISTER_BUF, &reg) < 0) {
+        return -1;
+    }
+    return reg.index;
+}
+
+static ssize_t fixed_io(int fd, unsigned long cmd, uint32_t index, size_t buf_offset, off_t pos, size_t len) {
+    struct rw_fixed_io io = { .index = index, .buf_offset = buf_offset, .pos = pos, .len = len };
+
+    return ioctl(fd, cmd, &io);
+}
+
+static int func_test(int fd) {
+    size_t len = 3 * 4096 + 100;
+    char *src = malloc(len), *dst = malloc(len);
+    int si, di;
+    uint32_t index;
+
+    for (size_t i = 0; i < len; i++) {
+        src[i] = (char)(i * 7 + 1);
+    }
+    si = register_buf(fd, src, len);
+    di = register_buf(fd, dst, len);
+    if (si < 0 || di < 0) {
+        perror("RW_IOC_REGISTER_BUF");
+        return -1;
+    }
+
+    // 从缓冲区偏移 123 写入存储偏移 5000，再读回到另一个缓冲区的偏移 77，跨越多页
+    if (fixed_io(fd, RW_IOC_WRITE_FIXED, si, 123, 5000, 10000) != 10000 ||
+        fixed_io(fd, RW_IOC_READ_FIXED, di, 77, 5000, 10000) != 10000) {
+        perror("fixed io");
+        return -1;
+    }
+    if (memcmp(src + 123, dst + 77, 10000) != 0) {
+        fprintf(stderr, "func: data mismatch\n");
+        return -1;
+    }
+
+    // 越过缓冲区末尾与不存在的编号都应失败
+    if (fixed_io(fd, RW_IOC_READ_FIXED, di, len - 10, 0, 11) >= 0 || errno != EINVAL ||
+        fixed_io(fd, RW_IOC_READ_FIXED, RW_MAX_FIXED_BUFS, 0, 0, 1) >= 0 || errno != EINVAL) {
+        fprintf(stderr, "func: bad range/index accepted\n");
+        return -1;
+    }
+
+    index = di;
+    if (ioctl(fd, RW_IOC_UNREGISTER_BUF, &index) < 0) {
+        perror("RW_IOC_UNREGISTER_BUF");
+        return -1;
+    }
+    if (fixed_io(fd, RW_IOC_READ_FIXED, di, 0, 0, 1) >= 0 || errno != ENOENT) {
+        fprintf(stderr, "func: unregistered buffer still usable\n");
+        return -1;
+    }
+    index = si;
+    ioctl(fd, RW_IOC_UNREGISTER_BUF, &index);
+    free(src);
+    free(dst);
+    printf("func: ok\n");
+    return 0;
+}
+
+// 每次传输 chunk 字节，依次覆盖存储的前 MAX_CHUNK 字节
+static double bench_prw(int fd, char *buf, size_t chunk, int write) {
+    size_t moved = 0;
+    off_t pos = 0;
+    uint64_t start = now_ns();
+
+    while (moved < TOTAL_BYTES) {
+        ssize_t n = write ? pwrite(fd, buf, chunk, pos) : pread(fd, buf, chunk, pos);
+        if (n != (ssize_t)chunk) {
+            perror(write ? "pwrite" : "pread");
+            break;
+        }
+        moved += n;
+        pos = (pos + chunk) % MAX_CHUNK;
+    }
+    return moved / ((now_ns() - start) / 1e9) / (1 << 20);
+}
+
+static double bench_fixed(int fd, int index, size_t chunk, int write) {
+    size_t moved = 0;
+    off_t pos = 0;
+    uint64_t start = now_ns();
+
+    while (moved < TOTAL_BYTES) {
+        ssize_t n = fixed_io(fd, write ? RW_IOC_WRITE_FIXED : RW_IOC_READ_FIXED, index, 0, pos, chunk);
+        if (n != (ssize_t)chunk) {
+            perror(write ? "RW_IOC_WRITE_FIXED" : "RW_IOC_READ_FIXED");
+            break;
+        }
+        moved += n;
+        pos = (pos + chunk) % MAX_CHUNK;
+    }
+    return moved / ((now_ns() - start) / 1e9) / (1 << 20);
+}
+
+int main(void) {
+    char *buf;
+    int fd, index;
+
+    fd = open(STORE_PATH, O_RDWR);
+    if (fd < 0) {
+        perror("open");
+        return EXIT_FAILURE;
+    }
+    if (func_test(fd) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    // 两种方式使用同一块缓冲区，预先触碰所有页，排除首次缺页的影响
+    if (posix_memalign((void **)&buf, 4096, MAX_CHUNK) != 0) {
+        perror("posix_memalign");
+        return EXIT_FAILURE;
+    }
+    memset(buf, 'x', MAX_CHUNK);
+    if (pwrite(fd, buf, MAX_CHUNK, 0) != (ssize_t)MAX_CHUNK) {
+        perror("prefill");
+        return EXIT_FAILURE;
+    }
+    index = register_buf(fd, buf, MAX_CHUNK);
+    if (index < 0) {
+        perror("RW_IOC_REGISTER_BUF");
+        return EXIT_FAILURE;
+    }
+
+    printf("%10s %14s %14s %14s %14s\n", "chunk", "pread MB/s", "fixed rd MB/s", "pwrite MB/s", "fixed wr MB/s");
+    for (size_t chunk = 64 << 10; chunk <= MAX_CHUNK; chunk *= 4) {
+        double pr = bench_prw(fd, buf, chunk, 0);
+        double fr = bench_fixed(fd, index, chunk, 0);
+        double pw = bench_prw(fd, buf, chunk, 1);
+        double fw = bench_fixed(fd, index, chunk, 1);
+        printf("%9zuK %14.1f %14.1f %14.1f %14.1f\n", chunk >> 10, pr, fr, pw, fw);
+    }
+
+    // 关闭文件时内核会解除仍登记着的缓冲区
+    close(fd);
+    free(buf);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/*
+ * readwrite_demo 并发压力测试：
+ *   priv：每个线程打开自己的 /dev/readwrite_demo_priv，写入各自的图案再读回，验证互不干扰；
+ *   snap：一个写者不断发布新快照，多个读者并发读取 /dev/readwrite_demo_snap，
+ *         验证每次读到的快照内容一致（不会读到半新半旧的数据），并报告读取吞吐随线程数的变化。
+ */
+
+#define PRIV_PATH "/dev/readwrite_demo_priv"
+#define SNAP_PATH "/dev/readwrite_demo_snap"
+#define BUFFER_SIZE 1024  // 与内核模块中的 BUFFER_SIZE 对应
+
+static volatile int stop;
+
+struct worker {
+    pthread_t tid;
+    int id;
+    unsigned long ops;
+    unsigned long errors;
+};
+
+// 私有缓冲区模式：写入本线程的图案后读回，内容必须完全一致
+static void *priv_worker(void *arg) {
+    struct worker *w = arg;
+    char wbuf[BUFFER_SIZE], rbuf[BUFFER_SIZE];
+    int fd = open(PRIV_PATH, O_RDWR);
+
+    if (fd < 0) {
+        perror("open " PRIV_PATH);
+        w->errors++;
+        return NULL;
+    }
+
+    while (!stop) {
+        size_t len = 1 + (w->ops * 7 + w->id) % BUFFER_SIZE;
+        memset(wbuf, 'A' + w->id % 26, len);
+        if (write(fd, wbuf, len) != (ssize_t)len ||
+            pread(fd, rbuf, sizeof(rbuf), 0) != (ssize_t)len ||
+            memcmp(wbuf, rbuf, len) != 0) {
+            w->errors++;
+        }
+        w->ops++;
+    }
+    close(fd);
+    return NULL;
+}
+
+// 快照写者：每个版本的所有字节相同，长度也随版本变化
+static void *snap_writer(void *arg) {
+    struct worker *w = arg;
+    char buf[BUFFER_SIZE];
+    int fd = open(SNAP_PATH, O_WRONLY);
+
+    if (fd < 0) {
+        perror("open " SNAP_PATH);
+        w->errors++;
+        return NULL;
+    }
+
+    while (!stop) {
+        size_t len = 1 + (w->ops * 13) % BUFFER_SIZE;
+        memset(buf, 'a' + w->ops % 26, len);
+        if (write(fd, buf, len) != (ssize_t)len) {
+            w->errors++;
+        }
+        w->ops++;
+        usleep(100);
+    }
+    close(fd);
+    return NULL;
+}
+
+// 快照读者：读到的每个快照必须是某个完整版本
+static void *snap_reader(void *arg) {
+    struct worker *w = arg;
+    char buf[BUFFER_SIZE];
+    int fd = open(SNAP_PATH, O_RDONLY);
+
+    if (fd < 0) {
+        perror("open " SNAP_PATH);
+        w->errors++;
+        return NULL;
+    }
+
+    while (!stop) {
+        ssize_t n = pread(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            w->errors++;
+        } else {
+            for (ssize_t i = 1; i < n; i++) {
+                if (buf[i] != buf[0]) {
+                    w->errors++;
+                    break;
+                }
+            }
+        }
+        w->ops++;
+    }
+    close(fd);
+    return NULL;
+}
+
+static unsigned long run_threads(struct worker *ws, int n, void *(*fn)(void *), int seconds,
+                                 unsigned long *errors) {
+    unsigned long ops = 0;
+
+    stop = 0;
+    for (int i = 0; i < n; i++) {
+        ws[i].id = i;
+        ws[i].ops = ws[i].errors = 0;
+        pthread_create(&ws[i].tid, NULL, fn, &ws[i]);
+    }
+    sleep(seconds);
+    stop = 1;
+    for (int i = 0; i < n; i++) {
+        pthread_join(ws[i].tid, NULL);
+        ops += ws[i].ops;
+        *errors += ws[i].errors;
+    }
+    return ops;
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    struct worker *ws = calloc(max_threads + 1, sizeof(*ws));
+    unsigned long errors = 0, total_errors = 0;
+
+    // 私有缓冲区模式
+    unsigned long ops = run_threads(ws, max_threads, priv_worker, seconds, &errors);
+    printf("priv: %d threads, %lu write+read pairs, %lu errors\n", max_threads, ops, errors);
+    total_errors += errors;
+
+    // 快照模式：读者线程数按 2 的幂递增，同时运行一个写者
+    for (int n = 1; n <= max_threads; n *= 2) {
+        struct worker writer = { 0 };
+        unsigned long reads;
+
+        errors = 0;
+        stop = 0;
+        pthread_create(&writer.tid, NULL, snap_writer, &writer);
+        reads = run_threads(ws, n, snap_reader, seconds, &errors);
+        pthread_join(writer.tid, NULL);
+        errors += writer.errors;
+
+        printf("snap: %3d readers, %10.0f reads/s (%8.0f per thread), %lu versions published, %lu errors\n",
+               n, (double)reads / seconds, (double)reads / seconds / n, writer.ops, errors);
+        total_errors += errors;
+    }
+
+    free(ws);
+    return total_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
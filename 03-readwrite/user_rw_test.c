@@ -3,47 +3,187 @@
 #include <fcntl.h>    // open
 #include <unistd.h>   // close, read, write
 #include <string.h>   // strlen
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <sys/uio.h>  // readv, writev
 
 #define DEVICE_PATH "/dev/readwrite_demo"
+#define STORE_PATH "/dev/readwrite_demo_store"
 
-int main() {
-    int fd;
+// 基本读写：设备是一个 FIFO，写入的数据会按顺序被读出
+static int basic_test(int fd) {
     char read_buf[1024] = {0};  // 读取缓冲区
     char write_buf[] = "Hello from Userspace!";  // 要写入的数据
 
-    // 打开设备文件
-    fd = open(DEVICE_PATH, O_RDWR);
-    if (fd < 0) {
-        perror("open");
-        return EXIT_FAILURE;
-    }
-
     // 先读取设备中已有的内容
-    if (read(fd, read_buf, sizeof(read_buf)) < 0) {
+    if (read(fd, read_buf, sizeof(read_buf) - 1) < 0) {
         perror("read");
-        close(fd);
-        return EXIT_FAILURE;
+        return -1;
     }
     printf("Read from device (before write): %s\n", read_buf);
 
     // 写入数据到设备
     if (write(fd, write_buf, strlen(write_buf)) < 0) {
         perror("write");
-        close(fd);
-        return EXIT_FAILURE;
+        return -1;
     }
     printf("Written to device: %s\n", write_buf);
 
-    // 再次读取设备内容
-    lseek(fd, 0, SEEK_SET);  // 重新定位文件偏移量
+    // 再次读取设备内容，FIFO 不需要 lseek
     memset(read_buf, 0, sizeof(read_buf));  // 清空读取缓冲区
-
-    if (read(fd, read_buf, sizeof(read_buf)) < 0) {
+    if (read(fd, read_buf, sizeof(read_buf) - 1) < 0) {
         perror("read");
+        return -1;
+    }
+    printf("Read from device (after write): %s\n", read_buf);
+    return 0;
+}
+
+// 非阻塞读：FIFO 为空时应立即返回 EAGAIN，而不是返回 0
+static int nonblock_test(void) {
+    char buf[64];
+    int fd = open(DEVICE_PATH, O_RDWR | O_NONBLOCK);
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EAGAIN) {
+        printf("Non-blocking read on empty FIFO: EAGAIN (ok)\n");
+    } else {
+        printf("Non-blocking read on empty FIFO returned %zd (unexpected)\n", n);
+    }
+    close(fd);
+    return n < 0 && errno == EAGAIN ? 0 : -1;
+}
+
+// epoll：子进程延迟写入，父进程通过 epoll 等待 POLLIN 后再读取
+static int epoll_test(int fd) {
+    struct epoll_event ev = { .events = EPOLLIN }, out;
+    char buf[64] = {0};
+    int epfd, n;
+    pid_t pid;
+
+    epfd = epoll_create1(0);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl");
+        close(epfd);
+        return -1;
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        usleep(200 * 1000);
+        if (write(fd, "ping", 4) < 0) {
+            perror("child write");
+        }
+        _exit(0);
+    }
+
+    n = epoll_wait(epfd, &out, 1, 2000);
+    if (n == 1 && (out.events & EPOLLIN)) {
+        if (read(fd, buf, sizeof(buf) - 1) < 0) {
+            perror("read");
+        }
+        printf("epoll reported POLLIN, read: %s\n", buf);
+    } else {
+        printf("epoll_wait returned %d (unexpected)\n", n);
+    }
+
+    waitpid(pid, NULL, 0);
+    close(epfd);
+    return n == 1 ? 0 : -1;
+}
+
+/*
+ * 分散/聚集 I/O：一次 writev 提交 头部 + 负载 两段，一次 readv 再拆到不同大小的缓冲区中。
+ * 驱动实现了 read_iter/write_iter，整个 iovec 数组在一次系统调用内处理。
+ */
+static int iov_test(int fd) {
+    char hdr[] = "HDR:";
+    char payload[] = "scatter-gather payload";
+    char part1[8] = {0}, part2[64] = {0};
+    struct iovec wiov[2] = {
+        { .iov_base = hdr, .iov_len = strlen(hdr) },
+        { .iov_base = payload, .iov_len = strlen(payload) },
+    };
+    struct iovec riov[2] = {
+        { .iov_base = part1, .iov_len = sizeof(part1) - 1 },
+        { .iov_base = part2, .iov_len = sizeof(part2) - 1 },
+    };
+    ssize_t total = wiov[0].iov_len + wiov[1].iov_len;
+
+    if (writev(fd, wiov, 2) != total) {
+        perror("writev");
+        return -1;
+    }
+    if (readv(fd, riov, 2) != total) {
+        perror("readv");
+        return -1;
+    }
+    printf("readv split: [%s] [%s]\n", part1, part2);
+    return 0;
+}
+
+/*
+ * 稀疏存储：在 256MB 处 pwrite，再用 lseek(SEEK_END) 得到存储大小，
+ * 空洞部分读出为 0，只有被写过的页才占用内核内存。
+ */
+static int store_test(void) {
+    const off_t far = 256L << 20;
+    char msg[] = "sparse hello";
+    char buf[32] = {0};
+    off_t end;
+    int ret = -1;
+    int fd = open(STORE_PATH, O_RDWR);
+
+    if (fd < 0) {
+        perror("open " STORE_PATH);
+        return -1;
+    }
+
+    if (pwrite(fd, msg, strlen(msg), far) != (ssize_t)strlen(msg)) {
+        perror("pwrite");
+        goto out;
+    }
+    end = lseek(fd, 0, SEEK_END);
+    if (pread(fd, buf, 8, 4096) != 8 || buf[0] != 0 || buf[7] != 0) {
+        printf("hole did not read back as zeros\n");
+        goto out;
+    }
+    if (pread(fd, buf, strlen(msg), far) != (ssize_t)strlen(msg)) {
+        perror("pread");
+        goto out;
+    }
+    printf("store: size %lld, read at %lld: %s\n", (long long)end, (long long)far, buf);
+    ret = strcmp(buf, msg) == 0 ? 0 : -1;
+out:
+    close(fd);
+    return ret;
+}
+
+int main() {
+    int fd;
+
+    // 打开设备文件
+    fd = open(DEVICE_PATH, O_RDWR);
+    if (fd < 0) {
+        perror("open");
+        return EXIT_FAILURE;
+    }
+
+    if (basic_test(fd) < 0 || iov_test(fd) < 0 || nonblock_test() < 0 || epoll_test(fd) < 0 ||
+        store_test() < 0) {
         close(fd);
         return EXIT_FAILURE;
     }
-    printf("Read from device (after write): %s\n", read_buf);
 
     // 关闭设备
     close(fd);
@@ -0,0 +1,59 @@
+#ifndef MMAP_DEMO_H
+#define MMAP_DEMO_H
+
+/*
+ * mmap_demo 内核模块与用户态程序共享的定义。
+ * 不同的 mmap 偏移量选择不同的映射区域：
+ *   - 0                  : 原始的单页缓冲区
+ *   - MMAP_RING_OFFSET   : SPSC 环形缓冲区（控制页 + 数据页）
+ *   - MMAP_LAZY_OFFSET   : 按需缺页分配的大缓冲区
+ *   - MMAP_HUGE_OFFSET   : 2MB 复合页支撑、以 PMD 映射的缓冲区（可选）
+ */
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define MMAP_RING_OFFSET 0x10000000ULL   // 环形缓冲区映射偏移（256MB）
+#define MMAP_LAZY_OFFSET 0x100000000ULL  // 按需缺页大缓冲区映射偏移（4GB）
+#define MMAP_HUGE_OFFSET 0x1000000000ULL // 大页缓冲区映射偏移（64GB，按 2MB 对齐）
+
+#define MMAP_RING_REC_SIZE 64            // 每条记录占一个 cache line
+
+/*
+ * 环形缓冲区控制页，位于映射区域的第一页。
+ * head 由内核生产者推进，tail 由用户态消费者推进，二者都是单调递增的计数，
+ * 槽位下标为 idx & (nr_slots - 1)。head/tail 分别独占一个 cache line，避免伪共享。
+ * 生产者：写记录 -> smp_store_release(head)；消费者：load_acquire(head) -> 读记录 -> store_release(tail)。
+ *
+ * 环满时生产者在 flags 中置 MMAP_RING_NEED_WAKEUP 后睡眠，消费者归还槽位后需要检查它：
+ *   store_release(tail) -> 全屏障 -> flags & MMAP_RING_NEED_WAKEUP 时 ioctl(fd, MMAP_RING_IOC_WAKEUP)
+ * 同一时刻只允许一个环形缓冲区映射（SPSC），已有映射时再次 mmap 返回 EBUSY，映射不会被 fork 继承。
+ * 最后一个映射解除时生产者线程停止，下一次映射时从原来的 head 继续。
+ * 内核只读取控制页中的 tail，其余字段每次映射时都由内核重新发布，用户写入它们不影响内核；
+ * tail 超出 [head - nr_slots, head] 时生产者按环满处理，下一次映射时 tail 被重置为 head。
+ */
+struct mmap_ring_ctrl {
+    __u64 head;          // 生产者写入位置（内核写，用户读）
+    __u8  pad0[56];
+    __u64 tail;          // 消费者读取位置（用户写，内核读）
+    __u8  pad1[56];
+    __u32 nr_slots;      // 记录槽数量，2 的幂
+    __u32 rec_size;      // 记录大小，等于 MMAP_RING_REC_SIZE
+    __u64 data_offset;   // 数据区相对映射起始的字节偏移
+    __u64 full_waits;    // 生产者因环满而等待的次数
+    __u32 flags;         // MMAP_RING_NEED_WAKEUP（内核写，用户读）
+    __u32 reserved;
+};
+
+#define MMAP_RING_NEED_WAKEUP (1U << 0)          // 生产者因环满而睡眠，需要消费者唤醒
+#define MMAP_RING_IOC_WAKEUP  _IO('m', 1)        // 唤醒睡眠中的生产者
+
+// 环形缓冲区中的一条记录
+struct mmap_ring_rec {
+    __u64 seq;           // 记录序号，等于写入时的 head
+    __u64 ts_ns;         // 生产时间戳（ktime_get_ns）
+    __u32 len;           // payload 有效长度
+    __u32 cpu;           // 生产者所在 CPU
+    __u8  payload[MMAP_RING_REC_SIZE - 24];
+};
+
+#endif // MMAP_DEMO_H
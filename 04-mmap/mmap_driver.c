@@ -6,22 +6,554 @@
 #include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/kthread.h>
+#include <linux/delay.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
+#include <linux/version.h>
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,16,0)
+#include <linux/pfn_t.h>
+#endif
+
+#include "mmap_demo.h"
+#include "u2k_stats.h"
+#include "u2k_lat.h"   // 延迟直方图（u2k_common.ko）
+#include "u2k_trace.h" // 跟踪点（u2k_common.ko）
 
 #define DEVICE_NAME "mmap_demo"   // 设备名称
 #define CLASS_NAME "mmap_class"   // 设备类名称
 #define MEM_SIZE PAGE_SIZE        // 分配一页内存的大小
 
+// mmap 调用与缺页次数统计，缺页路径可能在所有 CPU 上并发，使用 per-CPU 计数器
+enum {
+    MMAP_STAT_MMAP,       // mmap 调用次数
+    MMAP_STAT_LAZY_FAULT, // 按需缺页区域的缺页次数
+    MMAP_STAT_HUGE_PMD,   // 大页区域以 PMD 映射的次数
+    MMAP_STAT_HUGE_PTE,   // 大页区域以 4K 映射的次数
+    MMAP_STAT_NR,
+};
+static DEFINE_PER_CPU(struct u2k_stats, mmap_stats);
+
+// 延迟直方图 /proc/u2k/mmap：mmap 调用本身与各类缺页处理的耗时
+enum {
+    MMAP_LAT_MMAP,
+    MMAP_LAT_LAZY_FAULT,
+    MMAP_LAT_HUGE_PMD,
+    MMAP_LAT_HUGE_PTE,
+    MMAP_LAT_NR,
+};
+static const char *const mmap_lat_names[MMAP_LAT_NR] = {
+    "mmap", "lazy_fault", "huge_pmd", "huge_4k",
+};
+static struct u2k_lat *mmap_lat;
+
 static dev_t dev_num;             // 设备号
 static struct cdev mmap_cdev;     // 字符设备结构体
 static struct class *mmap_class;  // 设备类
 static struct device *mmap_device; // 设备结构体
 static char *kernel_buffer;       // 设备映射的内核缓冲区
 
-// mmap 处理函数
-static int mmap_driver_mmap(struct file *filp, struct vm_area_struct *vma) {
+// 环形缓冲区数据页数量（向下取整到 2 的幂），0 表示关闭环形缓冲区模式
+static unsigned int ring_pages = 256;
+module_param(ring_pages, uint, 0444);
+MODULE_PARM_DESC(ring_pages, "Number of data pages in the SPSC ring (0 disables ring mode)");
+
+static void *ring_area;                  // 控制页 + 数据页，vmalloc_user 分配
+static struct mmap_ring_ctrl *ring_ctrl; // 控制页
+static struct mmap_ring_rec *ring_data;  // 数据区
+static unsigned long ring_size;          // 整个环形区域大小（字节）
+/*
+ * 控制页对用户可写，内核使用的槽数、掩码、head 与计数都保存在这里的私有副本中，
+ * 只向控制页发布，从不读回；控制页中唯一被读取的是消费者的 tail，使用前检查范围。
+ */
+static u32 ring_nr_slots;
+static u32 ring_mask;
+static u64 ring_head;                    // 生产者写入位置，只由生产者线程（或没有线程时的 mmap）修改
+static u64 ring_full_waits;
+static struct task_struct *ring_task;    // 内核生产者线程，只在环被映射期间运行
+static unsigned int ring_maps;           // 环形区域的 vma 数（拆分后可能多于一个）
+static DEFINE_MUTEX(ring_lock);          // 保护 ring_task 与 ring_maps
+static DECLARE_WAIT_QUEUE_HEAD(ring_wq); // 环满时生产者在这里睡眠，MMAP_RING_IOC_WAKEUP 唤醒
+
+/*
+ * 消费者归还的 tail 只能落在 [head - nr_slots, head] 内。超前于 head 或落后超过一整圈
+ * 都说明消费者写坏了 tail，无符号减法使这两种情况都得到一个不小于 nr_slots 的值，按环满处理，不覆盖任何槽位。
+ */
+static bool ring_has_room(u64 tail) {
+    return ring_head - tail < ring_nr_slots;
+}
+
+// 内核生产者：持续向环中发布记录，环满时睡眠直到消费者唤醒
+static int ring_producer_fn(void *data) {
+    while (!kthread_should_stop()) {
+        struct mmap_ring_rec *rec;
+        // acquire：确保看到 tail 之后，消费者对这些槽位的读取已经完成
+        u64 tail = smp_load_acquire(&ring_ctrl->tail);
+
+        if (!ring_has_room(tail)) {
+            if (ring_head - tail > ring_nr_slots) {
+                pr_warn_ratelimited("mmap_driver: ring tail %llu out of range (head %llu)\n", tail, ring_head);
+            }
+            WRITE_ONCE(ring_ctrl->full_waits, ++ring_full_waits);
+            WRITE_ONCE(ring_ctrl->flags, MMAP_RING_NEED_WAKEUP);
+            /*
+             * 置位先于再次读取 tail，与消费者“写 tail -> 全屏障 -> 读 flags”配对：
+             * 要么这里看到新的 tail 不睡眠，要么消费者看到 NEED_WAKEUP 发起唤醒。
+             * kthread_stop 会直接唤醒本线程。
+             */
+            smp_mb();
+            wait_event_idle(ring_wq, kthread_should_stop() || ring_has_room(smp_load_acquire(&ring_ctrl->tail)));
+            WRITE_ONCE(ring_ctrl->flags, 0);
+            continue;
+        }
+
+        rec = &ring_data[ring_head & ring_mask];
+        rec->seq = ring_head;
+        rec->ts_ns = ktime_get_ns();
+        rec->cpu = raw_smp_processor_id();
+        rec->len = sizeof(u64);
+        memcpy(rec->payload, &ring_head, sizeof(u64));
+
+        // release：记录内容先于 head 对消费者可见
+        smp_store_release(&ring_ctrl->head, ++ring_head);
+
+        if ((ring_head & 1023) == 0) {
+            cond_resched();
+        }
+    }
+    return 0;
+}
+
+// vma 被拆分（部分 munmap、mprotect）时新的 vma 也计入映射数
+static void mmap_ring_vm_open(struct vm_area_struct *vma) {
+    mutex_lock(&ring_lock);
+    ring_maps++;
+    mutex_unlock(&ring_lock);
+}
+
+// 最后一个映射解除后停止生产者，没有消费者时不再占用 CPU
+static void mmap_ring_vm_close(struct vm_area_struct *vma) {
+    mutex_lock(&ring_lock);
+    if (--ring_maps == 0 && ring_task) {
+        kthread_stop(ring_task); // 在锁内等待退出，新的映射不会与旧线程同时生产
+        ring_task = NULL;
+    }
+    mutex_unlock(&ring_lock);
+}
+
+/*
+ * 向控制页重新发布布局与 head，覆盖之前的消费者可能写入的任何值；
+ * tail 越界时从 head 重新开始，丢弃未消费的记录。调用时生产者线程没有运行。
+ */
+static void mmap_ring_publish(void) {
+    ring_ctrl->nr_slots = ring_nr_slots;
+    ring_ctrl->rec_size = MMAP_RING_REC_SIZE;
+    ring_ctrl->data_offset = PAGE_SIZE;
+    ring_ctrl->full_waits = ring_full_waits;
+    ring_ctrl->flags = 0;
+    WRITE_ONCE(ring_ctrl->head, ring_head);
+    if (ring_head - READ_ONCE(ring_ctrl->tail) > ring_nr_slots) {
+        WRITE_ONCE(ring_ctrl->tail, ring_head);
+    }
+}
+
+static const struct vm_operations_struct mmap_ring_vm_ops = {
+        .open = mmap_ring_vm_open,
+        .close = mmap_ring_vm_close,
+};
+
+// 映射环形缓冲区并启动内核生产者；SPSC 只允许一个消费者，已有映射时返回 -EBUSY
+static int mmap_ring_mmap(struct vm_area_struct *vma) {
+    unsigned long size = vma->vm_end - vma->vm_start;
+    struct task_struct *task;
+    int ret;
+
+    if (!ring_area) {
+        return -ENODEV; // 环形缓冲区模式未开启
+    }
+    if (size > ring_size) {
+        return -EINVAL;
+    }
+
+    mutex_lock(&ring_lock);
+    if (ring_maps) {
+        ret = -EBUSY;
+        goto out;
+    }
+    mmap_ring_publish();
+    // 先启动线程再安装 vm_ops：失败返回时 vma 上还没有 close，不会把计数减成负数
+    task = kthread_run(ring_producer_fn, NULL, "mmap_ring_prod");
+    if (IS_ERR(task)) {
+        ret = PTR_ERR(task);
+        goto out;
+    }
+    ret = remap_vmalloc_range(vma, ring_area, 0);
+    if (ret) {
+        kthread_stop(task);
+        goto out;
+    }
+    vm_flags_set(vma, VM_DONTCOPY); // fork 出的子进程不会成为第二个消费者
+    vma->vm_ops = &mmap_ring_vm_ops;
+    ring_task = task;
+    ring_maps = 1;
+out:
+    mutex_unlock(&ring_lock);
+    return ret;
+}
+
+// 消费者发现 MMAP_RING_NEED_WAKEUP 后调用，唤醒因环满而睡眠的生产者
+static long mmap_driver_ioctl(struct file *filp, unsigned int cmd, unsigned long arg) {
+    switch (cmd) {
+        case MMAP_RING_IOC_WAKEUP:
+            if (!ring_area) {
+                return -ENODEV;
+            }
+            wake_up(&ring_wq);
+            return 0;
+        default:
+            return -ENOTTY;
+    }
+}
+
+// 分配并初始化环形缓冲区
+static int mmap_ring_init(void) {
+    unsigned int pages;
+
+    if (!ring_pages) {
+        return 0;
+    }
+
+    pages = rounddown_pow_of_two(ring_pages);
+    ring_size = (unsigned long)(pages + 1) * PAGE_SIZE;
+    ring_area = vmalloc_user(ring_size); // 已清零，且可以安全映射到用户空间
+    if (!ring_area) {
+        return -ENOMEM;
+    }
+
+    ring_ctrl = ring_area;
+    ring_data = ring_area + PAGE_SIZE;
+    ring_nr_slots = pages * (PAGE_SIZE / MMAP_RING_REC_SIZE);
+    ring_mask = ring_nr_slots - 1;
+    mmap_ring_publish();
+    return 0;
+}
+
+// 按需缺页缓冲区大小（MB），0 表示关闭
+static unsigned int lazy_size_mb = 256;
+module_param(lazy_size_mb, uint, 0444);
+MODULE_PARM_DESC(lazy_size_mb, "Size in MB of the lazily faulted buffer (0 disables it)");
+
+#define LAZY_PGOFF (MMAP_LAZY_OFFSET >> PAGE_SHIFT)
+
+static struct page **lazy_pages;          // 每个槽位在首次访问时才分配物理页
+static unsigned long lazy_nr_pages;       // 缓冲区总页数
+static atomic_long_t lazy_populated;      // 已分配的物理页数
+
+/*
+ * 缺页处理：首次访问某一页时才分配物理页。
+ * 多个进程/线程可能同时缺页，用 cmpxchg 安装页面，失败的一方释放自己分配的页。
+ * MAP_POPULATE 会在 mmap 返回前对整个区域触发缺页，因此预取语义自然得到保留。
+ */
+static vm_fault_t mmap_lazy_do_fault(struct vm_fault *vmf) {
+    unsigned long idx = vmf->pgoff - LAZY_PGOFF;
+    struct page *page, *old;
+
+    if (idx >= lazy_nr_pages) {
+        return VM_FAULT_SIGBUS;
+    }
+    u2k_stats_inc(mmap_stats, MMAP_STAT_LAZY_FAULT);
+
+    page = READ_ONCE(lazy_pages[idx]);
+    if (!page) {
+        page = alloc_page(GFP_HIGHUSER | __GFP_ZERO);
+        if (!page) {
+            return VM_FAULT_OOM;
+        }
+        old = cmpxchg(&lazy_pages[idx], NULL, page);
+        if (old) {
+            __free_page(page);
+            page = old;
+        } else {
+            atomic_long_inc(&lazy_populated);
+        }
+    }
+
+    get_page(page); // 引用由内核在解除映射时释放
+    vmf->page = page;
+    return 0;
+}
+
+static vm_fault_t mmap_lazy_fault(struct vm_fault *vmf) {
+    u64 start = u2k_lat_start();
+    vm_fault_t ret = mmap_lazy_do_fault(vmf);
+
+    u2k_lat_end(mmap_lat, MMAP_LAT_LAZY_FAULT, start);
+    return ret;
+}
+
+static const struct vm_operations_struct mmap_lazy_vm_ops = {
+        .fault = mmap_lazy_fault,
+};
+
+// 映射按需缺页缓冲区：这里只登记 vm_ops，不建立任何页表项
+static int mmap_lazy_mmap(struct vm_area_struct *vma) {
+    unsigned long start = vma->vm_pgoff - LAZY_PGOFF;
+
+    if (start + vma_pages(vma) > lazy_nr_pages) {
+        return -EINVAL;
+    }
+
+    vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+    vma->vm_ops = &mmap_lazy_vm_ops;
+    return 0;
+}
+
+static int mmap_lazy_init(void) {
+    lazy_nr_pages = (unsigned long)lazy_size_mb << (20 - PAGE_SHIFT);
+    if (!lazy_nr_pages) {
+        return 0;
+    }
+
+    // 只分配页指针数组，物理页在缺页时分配
+    lazy_pages = kvcalloc(lazy_nr_pages, sizeof(*lazy_pages), GFP_KERNEL);
+    if (!lazy_pages) {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+static void mmap_lazy_exit(void) {
+    unsigned long i;
+
+    if (!lazy_pages) {
+        return;
+    }
+    for (i = 0; i < lazy_nr_pages; i++) {
+        if (lazy_pages[i]) {
+            __free_page(lazy_pages[i]);
+        }
+    }
+    kvfree(lazy_pages);
+    printk(KERN_INFO "mmap_driver: lazy buffer populated %ld of %lu pages\n",
+           atomic_long_read(&lazy_populated), lazy_nr_pages);
+}
+
+// 大页缓冲区大小（MB，按 2MB 向下取整），默认关闭
+static unsigned int huge_size_mb;
+module_param(huge_size_mb, uint, 0444);
+MODULE_PARM_DESC(huge_size_mb, "Size in MB of the 2MB-page backed buffer (0 disables it)");
+
+#define HUGE_PGOFF (MMAP_HUGE_OFFSET >> PAGE_SHIFT)
+#define HUGE_ORDER (PMD_SHIFT - PAGE_SHIFT)   // 2MB 复合页的阶数
+#define HUGE_NR    (1UL << HUGE_ORDER)        // 每个 2MB 块包含的 4K 页数
+
+/*
+ * 每个 2MB 块优先使用一个复合页；分配失败时退化为 HUGE_NR 个独立的 4K 页，
+ * 该块之后只能以 4K 页表项映射。
+ */
+struct huge_chunk {
+    struct page *huge;    // 2MB 复合页，失败时为 NULL
+    struct page **small;  // 退化时使用的 4K 页
+};
+
+static struct huge_chunk *huge_chunks;
+static unsigned long huge_nr_chunks;
+
+static struct page *huge_lookup(unsigned long idx) {
+    struct huge_chunk *chunk = &huge_chunks[idx / HUGE_NR];
+
+    if (chunk->huge) {
+        return chunk->huge + (idx % HUGE_NR);
+    }
+    return chunk->small[idx % HUGE_NR];
+}
+
+// 4K 缺页处理：PMD 映射不可用（未对齐、THP 关闭或该块没有复合页）时走这里
+static vm_fault_t mmap_huge_fault(struct vm_fault *vmf) {
+    unsigned long idx = vmf->pgoff - HUGE_PGOFF;
+    u64 start = u2k_lat_start();
+    vm_fault_t ret;
+
+    if (idx >= huge_nr_chunks * HUGE_NR) {
+        return VM_FAULT_SIGBUS;
+    }
+    u2k_stats_inc(mmap_stats, MMAP_STAT_HUGE_PTE);
+    ret = vmf_insert_pfn(vmf->vma, vmf->address, page_to_pfn(huge_lookup(idx)));
+    u2k_lat_end(mmap_lat, MMAP_LAT_HUGE_PTE, start);
+    return ret;
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * PMD 缺页处理：虚拟地址和文件偏移都按 2MB 对齐、整个 2MB 落在 vma 内、
+ * 且该块有复合页时，直接安装一个 PMD 表项，否则返回 VM_FAULT_FALLBACK 退回 4K 路径。
+ */
+static vm_fault_t mmap_huge_pmd_fault(struct vm_fault *vmf) {
+    struct vm_area_struct *vma = vmf->vma;
+    unsigned long addr = vmf->address & PMD_MASK;
+    unsigned long idx;
+    struct huge_chunk *chunk;
+    u64 start = u2k_lat_start();
+    vm_fault_t ret;
+
+    if (addr < vma->vm_start || addr + PMD_SIZE > vma->vm_end) {
+        return VM_FAULT_FALLBACK;
+    }
+    idx = vma->vm_pgoff - HUGE_PGOFF + ((addr - vma->vm_start) >> PAGE_SHIFT);
+    if (idx % HUGE_NR || idx >= huge_nr_chunks * HUGE_NR) {
+        return VM_FAULT_FALLBACK;
+    }
+    chunk = &huge_chunks[idx / HUGE_NR];
+    if (!chunk->huge) {
+        return VM_FAULT_FALLBACK;
+    }
+
+    u2k_stats_inc(mmap_stats, MMAP_STAT_HUGE_PMD);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,16,0)
+    ret = vmf_insert_pfn_pmd(vmf, page_to_pfn(chunk->huge), vmf->flags & FAULT_FLAG_WRITE);
+#else
+    ret = vmf_insert_pfn_pmd(vmf, __pfn_to_pfn_t(page_to_pfn(chunk->huge), PFN_DEV),
+                             vmf->flags & FAULT_FLAG_WRITE);
+#endif
+    u2k_lat_end(mmap_lat, MMAP_LAT_HUGE_PMD, start);
+    return ret;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,6,0)
+static vm_fault_t mmap_huge_huge_fault(struct vm_fault *vmf, unsigned int order) {
+    if (order != PMD_ORDER) {
+        return VM_FAULT_FALLBACK;
+    }
+    return mmap_huge_pmd_fault(vmf);
+}
+#else
+static vm_fault_t mmap_huge_huge_fault(struct vm_fault *vmf, enum page_entry_size pe_size) {
+    if (pe_size != PE_SIZE_PMD) {
+        return VM_FAULT_FALLBACK;
+    }
+    return mmap_huge_pmd_fault(vmf);
+}
+#endif
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+
+static const struct vm_operations_struct mmap_huge_vm_ops = {
+        .fault = mmap_huge_fault,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+        .huge_fault = mmap_huge_huge_fault,
+#endif
+};
+
+/*
+ * 映射大页缓冲区。页面在模块加载时已经分配好，以 VM_PFNMAP 方式插入，
+ * 不参与引用计数；VM_HUGEPAGE 让 THP 处于 madvise 模式时也会调用 .huge_fault。
+ */
+static int mmap_huge_mmap(struct vm_area_struct *vma) {
+    unsigned long start = vma->vm_pgoff - HUGE_PGOFF;
+
+    if (!(vma->vm_flags & VM_SHARED)) {
+        return -EINVAL; // PFNMAP 不支持写时复制
+    }
+    if (start + vma_pages(vma) > huge_nr_chunks * HUGE_NR) {
+        return -EINVAL;
+    }
+
+    vm_flags_set(vma, VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP | VM_HUGEPAGE);
+    vma->vm_ops = &mmap_huge_vm_ops;
+    return 0;
+}
+
+static void mmap_huge_exit(void) {
+    unsigned long i, j;
+
+    if (!huge_chunks) {
+        return;
+    }
+    for (i = 0; i < huge_nr_chunks; i++) {
+        if (huge_chunks[i].huge) {
+            __free_pages(huge_chunks[i].huge, HUGE_ORDER);
+        } else if (huge_chunks[i].small) {
+            for (j = 0; j < HUGE_NR; j++) {
+                if (huge_chunks[i].small[j]) {
+                    __free_page(huge_chunks[i].small[j]);
+                }
+            }
+            kfree(huge_chunks[i].small);
+        }
+    }
+    kvfree(huge_chunks);
+}
+
+// 分配大页缓冲区，每个 2MB 块优先分配复合页，失败时退化为 4K 页
+static int mmap_huge_init(void) {
+    unsigned long i, j, fallback = 0;
+
+    huge_nr_chunks = ((unsigned long)huge_size_mb << 20) >> PMD_SHIFT;
+    if (!huge_nr_chunks) {
+        return 0;
+    }
+
+    huge_chunks = kvcalloc(huge_nr_chunks, sizeof(*huge_chunks), GFP_KERNEL);
+    if (!huge_chunks) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < huge_nr_chunks; i++) {
+        huge_chunks[i].huge = alloc_pages(GFP_KERNEL | __GFP_COMP | __GFP_ZERO |
+                                          __GFP_NOWARN | __GFP_NORETRY, HUGE_ORDER);
+        if (huge_chunks[i].huge) {
+            continue;
+        }
+
+        fallback++;
+        huge_chunks[i].small = kcalloc(HUGE_NR, sizeof(struct page *), GFP_KERNEL);
+        if (!huge_chunks[i].small) {
+            goto err;
+        }
+        for (j = 0; j < HUGE_NR; j++) {
+            huge_chunks[i].small[j] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+            if (!huge_chunks[i].small[j]) {
+                goto err;
+            }
+        }
+    }
+
+    printk(KERN_INFO "mmap_driver: huge buffer %lu x 2MB chunks, %lu fell back to 4K pages\n",
+           huge_nr_chunks, fallback);
+    return 0;
+
+err:
+    mmap_huge_exit();
+    huge_chunks = NULL;
+    huge_nr_chunks = 0;
+    return -ENOMEM;
+}
+
+// 卸载时不会有映射（映射持有文件，文件持有模块引用），生产者已经停止
+static void mmap_ring_exit(void) {
+    vfree(ring_area);
+}
+
+// 根据映射偏移选择区域并建立映射
+static int mmap_driver_map_region(struct vm_area_struct *vma) {
     unsigned long size = vma->vm_end - vma->vm_start; // 计算映射的大小
     unsigned long pfn;
 
+    u2k_stats_inc(mmap_stats, MMAP_STAT_MMAP);
+
+    // 根据映射偏移选择区域
+    if (vma->vm_pgoff == (MMAP_RING_OFFSET >> PAGE_SHIFT)) {
+        return mmap_ring_mmap(vma);
+    }
+    if (vma->vm_pgoff >= LAZY_PGOFF && vma->vm_pgoff < LAZY_PGOFF + lazy_nr_pages) {
+        return mmap_lazy_mmap(vma);
+    }
+    if (vma->vm_pgoff >= HUGE_PGOFF && vma->vm_pgoff < HUGE_PGOFF + huge_nr_chunks * HUGE_NR) {
+        return mmap_huge_mmap(vma);
+    }
+
     // 确保用户映射的大小不超过内核分配的缓冲区大小
     if (size > MEM_SIZE) {
         return -EINVAL; // 返回无效参数错误
@@ -38,10 +570,27 @@ static int mmap_driver_mmap(struct file *filp, struct vm_area_struct *vma) {
     return 0; // 映射成功
 }
 
+// mmap 处理函数
+static int mmap_driver_mmap(struct file *filp, struct vm_area_struct *vma) {
+    u64 start;
+    int ret;
+
+    trace_u2k_mmap_enter(vma->vm_pgoff, vma->vm_end - vma->vm_start);
+    start = u2k_lat_start();
+    ret = mmap_driver_map_region(vma);
+    u2k_lat_end(mmap_lat, MMAP_LAT_MMAP, start);
+    trace_u2k_mmap_exit(vma->vm_pgoff, ret);
+    return ret;
+}
+
 // 文件操作结构体，定义 mmap 设备的操作
 static struct file_operations fops = {
         .owner = THIS_MODULE,
         .mmap = mmap_driver_mmap, // 绑定 mmap 处理函数
+        .unlocked_ioctl = mmap_driver_ioctl,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+        .get_unmapped_area = thp_get_unmapped_area, // 大映射按 2MB 对齐虚拟地址
+#endif
 };
 
 // 模块初始化
@@ -97,12 +646,68 @@ static int __init mmap_driver_init(void) {
     // 预填充一些数据，用户 mmap 后可以看到这个数据
     snprintf(kernel_buffer, MEM_SIZE, "Hello from Kernel!");
 
+    // 分配环形缓冲区
+    ret = mmap_ring_init();
+    if (ret < 0) {
+        kfree(kernel_buffer);
+        device_destroy(mmap_class, dev_num);
+        class_destroy(mmap_class);
+        cdev_del(&mmap_cdev);
+        unregister_chrdev_region(dev_num, 1);
+        printk(KERN_ERR "Failed to allocate ring buffer\n");
+        return ret;
+    }
+
+    // 分配按需缺页缓冲区的页指针数组
+    ret = mmap_lazy_init();
+    if (ret < 0) {
+        mmap_ring_exit();
+        kfree(kernel_buffer);
+        device_destroy(mmap_class, dev_num);
+        class_destroy(mmap_class);
+        cdev_del(&mmap_cdev);
+        unregister_chrdev_region(dev_num, 1);
+        printk(KERN_ERR "Failed to allocate lazy buffer\n");
+        return ret;
+    }
+
+    // 分配大页缓冲区（可选）
+    ret = mmap_huge_init();
+    if (ret < 0) {
+        mmap_lazy_exit();
+        mmap_ring_exit();
+        kfree(kernel_buffer);
+        device_destroy(mmap_class, dev_num);
+        class_destroy(mmap_class);
+        cdev_del(&mmap_cdev);
+        unregister_chrdev_region(dev_num, 1);
+        printk(KERN_ERR "Failed to allocate huge buffer\n");
+        return ret;
+    }
+
+    // 观测失败不影响驱动本身，mmap_lat 为 NULL 时不记录
+    mmap_lat = u2k_lat_register("mmap", mmap_lat_names, MMAP_LAT_NR);
+    if (IS_ERR(mmap_lat)) {
+        printk(KERN_WARNING "Failed to register /proc/u2k/mmap\n");
+        mmap_lat = NULL;
+    }
+
     printk(KERN_INFO "mmap_driver loaded successfully\n");
     return 0;
 }
 
 // 模块卸载
 static void __exit mmap_driver_exit(void) {
+    u64 stats[MMAP_STAT_NR];
+
+    u2k_stats_sum(&mmap_stats, stats, MMAP_STAT_NR);
+    printk(KERN_INFO "mmap_driver: %llu mmap calls, %llu lazy faults, huge PMD faults %llu, 4K faults %llu\n",
+           stats[MMAP_STAT_MMAP], stats[MMAP_STAT_LAZY_FAULT], stats[MMAP_STAT_HUGE_PMD],
+           stats[MMAP_STAT_HUGE_PTE]);
+    u2k_lat_unregister(mmap_lat);
+    mmap_huge_exit();                   // 释放大页缓冲区
+    mmap_lazy_exit();                   // 释放按需缺页缓冲区
+    mmap_ring_exit();                   // 停止生产者并释放环形缓冲区
     kfree(kernel_buffer);               // 释放内核缓冲区
     device_destroy(mmap_class, dev_num); // 销毁设备节点
     class_destroy(mmap_class);           // 销毁设备类
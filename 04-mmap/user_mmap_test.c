@@ -3,17 +3,232 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+
+#include "mmap_demo.h"
 
 #define DEVICE_PATH "/dev/mmap_demo" // 设备文件路径，对应内核模块注册的字符设备
 #define MEM_SIZE 4096 // 映射的内存大小，与内核模块中的 MEM_SIZE 对应
 
-int main() {
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * 环形缓冲区消费者：映射控制页和数据页，不经过任何系统调用地消费内核发布的记录。
+ * 只允许一个消费者（SPSC）。
+ */
+static int ring_consume(int fd, int seconds) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    struct mmap_ring_ctrl *ctrl;
+    struct mmap_ring_rec *data;
+    size_t map_size;
+    uint64_t tail, mask, consumed = 0, bad_seq = 0, empty_polls = 0, wakeups = 0;
+    uint64_t start, deadline;
+    void *area;
+
+    // 先映射控制页获取环的大小，再映射整个区域
+    ctrl = mmap(NULL, page_size, PROT_READ, MAP_SHARED, fd, MMAP_RING_OFFSET);
+    if (ctrl == MAP_FAILED) {
+        perror("mmap ring ctrl");
+        return EXIT_FAILURE;
+    }
+    map_size = ctrl->data_offset + (size_t)ctrl->nr_slots * ctrl->rec_size;
+    munmap(ctrl, page_size);
+
+    area = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, MMAP_RING_OFFSET);
+    if (area == MAP_FAILED) {
+        perror("mmap ring");
+        return EXIT_FAILURE;
+    }
+    ctrl = area;
+    data = (struct mmap_ring_rec *)((char *)area + ctrl->data_offset);
+    mask = ctrl->nr_slots - 1;
+    tail = __atomic_load_n(&ctrl->tail, __ATOMIC_RELAXED);
+
+    printf("Ring: %u slots x %u bytes, consuming for %d s\n", ctrl->nr_slots, ctrl->rec_size, seconds);
+
+    start = now_ns();
+    deadline = start + (uint64_t)seconds * 1000000000ULL;
+    while (now_ns() < deadline) {
+        // acquire：看到 head 后，对应记录的内容一定已经写完
+        uint64_t head = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            if (++empty_polls % 1024 == 0) {
+                sched_yield();
+            }
+            continue;
+        }
+
+        while (tail != head) {
+            struct mmap_ring_rec *rec = &data[tail & mask];
+            if (rec->seq != tail) {
+                bad_seq++;
+            }
+            tail++;
+            consumed++;
+        }
+        // release：归还槽位，内核在此之后才会覆盖它们
+        __atomic_store_n(&ctrl->tail, tail, __ATOMIC_RELEASE);
+        // 全屏障：先让 tail 可见再读 flags，与生产者睡眠前的 smp_mb 配对，唤醒不会丢失
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ctrl->flags, __ATOMIC_RELAXED) & MMAP_RING_NEED_WAKEUP) {
+            ioctl(fd, MMAP_RING_IOC_WAKEUP);
+            wakeups++;
+        }
+    }
+
+    double secs = (now_ns() - start) / 1e9;
+    printf("Consumed %llu records in %.2f s (%.2f M records/s), bad seq %llu, producer full waits %llu, "
+           "wakeups %llu\n",
+           (unsigned long long)consumed, secs, consumed / secs / 1e6,
+           (unsigned long long)bad_seq, (unsigned long long)ctrl->full_waits, (unsigned long long)wakeups);
+
+    munmap(area, map_size);
+    return bad_seq ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// 读取当前进程的常驻内存（KB），用于观察按需缺页的效果
+static long rss_kb(void) {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/*
+ * 按需缺页缓冲区测试：映射 size_mb 大小的区域，只访问其中的 1/stride，
+ * 比较 mmap 耗时和常驻内存；populate 非零时使用 MAP_POPULATE 预取全部页面。
+ */
+static int lazy_test(int fd, size_t size_mb, int populate) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t size = size_mb << 20;
+    size_t stride = 64 * page_size; // 每 64 页访问一页
+    uint64_t t0, t1, t2;
+    char *buf;
+
+    t0 = now_ns();
+    buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | (populate ? MAP_POPULATE : 0),
+               fd, MMAP_LAZY_OFFSET);
+    if (buf == MAP_FAILED) {
+        perror("mmap lazy");
+        return EXIT_FAILURE;
+    }
+    t1 = now_ns();
+    printf("mmap %zu MB%s: %.3f ms, RSS %ld KB\n", size_mb, populate ? " (MAP_POPULATE)" : "",
+           (t1 - t0) / 1e6, rss_kb());
+
+    for (size_t off = 0; off < size; off += stride) {
+        buf[off] = (char)off;
+    }
+    t2 = now_ns();
+    printf("touched %zu pages: %.3f ms, RSS %ld KB\n", size / stride, (t2 - t1) / 1e6, rss_kb());
+
+    munmap(buf, size);
+    return EXIT_SUCCESS;
+}
+
+// 顺序扫描：每个 cache line 读取一个 uint64，返回吞吐（GB/s）
+static double scan_gbps(const char *buf, size_t size, int rounds, uint64_t *sum) {
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t off = 0; off < size; off += 64) {
+            *sum += *(const volatile uint64_t *)(buf + off);
+        }
+    }
+    return (double)size * rounds / (now_ns() - start);
+}
+
+// 跨页扫描：每页只读取一个 uint64，几乎每次访问都是一次 TLB 查找，返回每次访问的纳秒数
+static double stride_ns(const char *buf, size_t size, int rounds, long page_size, uint64_t *sum) {
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t off = 0; off < size; off += page_size) {
+            *sum += *(const volatile uint64_t *)(buf + off);
+        }
+    }
+    return (double)(now_ns() - start) / ((double)(size / page_size) * rounds);
+}
+
+/*
+ * 4K 与 2MB 映射的扫描对比：4K 映射使用按需缺页缓冲区，2MB 映射使用大页缓冲区
+ * （需要以 huge_size_mb>=size_mb 加载模块，并且 THP 处于 always 或 madvise 模式）。
+ */
+static int scan_bench(int fd, size_t size_mb, int rounds) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t size = size_mb << 20;
+    const struct {
+        const char *name;
+        off_t offset;
+    } modes[] = {
+        { "4K pages", MMAP_LAZY_OFFSET },
+        { "2MB pages", MMAP_HUGE_OFFSET },
+    };
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        char *buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, modes[i].offset);
+        if (buf == MAP_FAILED) {
+            perror(modes[i].name);
+            return EXIT_FAILURE;
+        }
+
+        // 预热：先触发所有缺页，计时只包含访问本身
+        for (size_t off = 0; off < size; off += page_size) {
+            buf[off] = 1;
+        }
+
+        double gbps = scan_gbps(buf, size, rounds, &sum);
+        double ns = stride_ns(buf, size, rounds * 16, page_size, &sum);
+        printf("%-10s: sequential %.2f GB/s, page-stride %.2f ns/access\n", modes[i].name, gbps, ns);
+        munmap(buf, size);
+    }
+
+    printf("(checksum %llu)\n", (unsigned long long)sum);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
     // 打开字符设备文件，使用 O_RDWR 以读写模式访问
     int fd = open(DEVICE_PATH, O_RDWR);
     if (fd < 0) {
         perror("open");
         return EXIT_FAILURE;
     }
+
+    // ./user_mmap_test ring [秒数]：运行环形缓冲区消费者
+    if (argc > 1 && strcmp(argv[1], "ring") == 0) {
+        int ret = ring_consume(fd, argc > 2 ? atoi(argv[2]) : 5);
+        close(fd);
+        return ret;
+    }
+
+    // ./user_mmap_test lazy [MB] [populate]：测试按需缺页的大缓冲区
+    if (argc > 1 && strcmp(argv[1], "lazy") == 0) {
+        int ret = lazy_test(fd, argc > 2 ? strtoul(argv[2], NULL, 0) : 256, argc > 3 && atoi(argv[3]));
+        close(fd);
+        return ret;
+    }
+
+    // ./user_mmap_test scan [MB] [轮数]：比较 4K 与 2MB 映射的扫描吞吐
+    if (argc > 1 && strcmp(argv[1], "scan") == 0) {
+        int ret = scan_bench(fd, argc > 2 ? strtoul(argv[2], NULL, 0) : 64, argc > 3 ? atoi(argv[3]) : 10);
+        close(fd);
+        return ret;
+    }
+
     /*
      申请内存映射，将设备文件映射到用户空间，mmap 是一个系统调用。
      参数解析：
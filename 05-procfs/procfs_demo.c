@@ -1,84 +1,274 @@
 #include <linux/module.h>    // 内核模块头文件
 #include <linux/kernel.h>    // 内核日志
 #include <linux/proc_fs.h>   // proc 文件系统
+#include <linux/seq_file.h>  // seq_file 迭代器
 #include <linux/uaccess.h>   // 用户空间数据交互 API（copy_to_user, copy_from_user）
 #include <linux/slab.h>      // kmalloc/kfree
+#include <linux/xarray.h>    // 按序号索引的记录表
+#include <linux/mutex.h>
+#include "../common/u2k_stats.h"  // per-CPU 统计计数器（本目录没有 Makefile，按相对路径包含）
+#include "../common/u2k_lat.h"    // 延迟直方图（u2k_common.ko）
+#include "../common/u2k_trace.h"  // 跟踪点（u2k_common.ko）
 
 #define PROC_FILENAME "procfs_demo"   // /proc 目录下的文件名
-#define BUFFER_SIZE 1024              // 缓冲区大小
+#define RECORD_MAX 1024               // 单条记录的最大长度
+
+/*
+ * /proc/procfs_demo 保存一组文本记录，每次 write 追加一条，read 按行输出全部记录：
+ *   <序号> <内容>
+ * 读取基于 seq_file 迭代器：每次只把能放进一页的记录格式化到 seq_file 的缓冲区，
+ * 读到哪里由 seq_file 记录的记录序号决定，整个输出从不会一次性放在内存中，
+ * 因此几万甚至上百万条记录也可以分页流式读出，lseek/pread 也能从任意偏移继续。
+ */
+struct proc_record {
+    u32 len;
+    char data[];
+};
 
 static struct proc_dir_entry *proc_file;  // /proc 文件指针
-static char *kernel_buffer;  // 内核缓冲区
-static int data_size = 0;  // 当前数据长度
+static DEFINE_XARRAY_ALLOC(proc_records); // 序号 -> struct proc_record，序号从 0 连续分配
+static DEFINE_MUTEX(proc_write_lock);     // 串行化追加，保证字节上限的检查与计数一致
+static unsigned long proc_nr_records;     // 当前记录数
+static size_t proc_write_bytes;           // write 追加的记录占用的字节数（含记录头）
+
+// 加载时预先生成的合成记录数，用于测试大输出
+static unsigned int nr_records;
+module_param(nr_records, uint, 0444);
+MODULE_PARM_DESC(nr_records, "Number of synthetic records created at load time");
+
+// 文件对所有用户可写，write 追加的记录总共最多占用这么多内存，防止普通用户无限追加耗尽内存
+static unsigned int max_write_kb = 4096;
+module_param(max_write_kb, uint, 0644);
+MODULE_PARM_DESC(max_write_kb, "Maximum KB held by records appended through write(), further writes fail with ENOSPC");
+
+enum {
+    PROC_STAT_READ,
+    PROC_STAT_READ_BYTES,
+    PROC_STAT_WRITE,
+    PROC_STAT_WRITE_BYTES,
+    PROC_STAT_NR,
+};
+static DEFINE_PER_CPU(struct u2k_stats, proc_stats);  // 读写次数与字节数
+
+// 延迟直方图 /proc/u2k/procfs
+enum {
+    PROC_LAT_READ,
+    PROC_LAT_WRITE,
+    PROC_LAT_NR,
+};
+static const char *const proc_lat_names[PROC_LAT_NR] = { "read", "write" };
+static struct u2k_lat *proc_lat;
+
+/*
+ * seq_file 迭代器。*pos 是记录序号，seq_file 在两次 read 之间保存它，
+ * 下一次 read 直接从 xa_load(*pos) 继续，不需要从头遍历。
+ * 记录只会追加、直到模块卸载才释放，因此迭代期间不需要持锁。
+ */
+static void *proc_seq_start(struct seq_file *m, loff_t *pos) {
+    return xa_load(&proc_records, *pos);
+}
+
+static void *proc_seq_next(struct seq_file *m, void *v, loff_t *pos) {
+    ++*pos;
+    return xa_load(&proc_records, *pos);
+}
+
+static void proc_seq_stop(struct seq_file *m, void *v) {
+}
+
+static int proc_seq_show(struct seq_file *m, void *v) {
+    const struct proc_record *rec = v;
 
-// 读取 /proc/procfs_demo 文件的内容
+    seq_printf(m, "%llu %.*s\n", (unsigned long long)m->index, rec->len, rec->data);
+    return 0;
+}
+
+static const struct seq_operations proc_seq_ops = {
+    .start = proc_seq_start,
+    .next = proc_seq_next,
+    .stop = proc_seq_stop,
+    .show = proc_seq_show,
+};
+
+static int proc_open(struct inode *inode, struct file *file) {
+    return seq_open(file, &proc_seq_ops);
+}
+
+// 读取 /proc/procfs_demo 文件的内容，由 seq_read 分页生成
 static ssize_t proc_read(struct file *file, char __user *user_buf, size_t count, loff_t *pos) {
-    if (*pos >= data_size) {
-        return 0;  // 没有更多数据可读
-    }
+    u64 start;
+    ssize_t ret;
 
-    if (count > data_size - *pos) {
-        count = data_size - *pos;  // 限制读取数据大小
+    trace_u2k_proc_enter(false, count, *pos);
+    start = u2k_lat_start();
+    ret = seq_read(file, user_buf, count, pos);
+    u2k_lat_end(proc_lat, PROC_LAT_READ, start);
+    trace_u2k_proc_exit(false, ret);
+    if (ret > 0) {
+        u2k_stats_inc(proc_stats, PROC_STAT_READ);
+        u2k_stats_add(proc_stats, PROC_STAT_READ_BYTES, ret);
     }
+    return ret;
+}
 
-    if (copy_to_user(user_buf, kernel_buffer + *pos, count) != 0) {
-        return -EFAULT;  // 复制失败
+static struct proc_record *proc_record_alloc(size_t len) {
+    struct proc_record *rec = kmalloc(struct_size(rec, data, len), GFP_KERNEL);
+
+    if (rec) {
+        rec->len = len;
     }
+    return rec;
+}
+
+/*
+ * 把记录加入记录表，失败时释放记录；调用者持有 proc_write_lock 或处于模块初始化中。
+ * charge 为 true 时（来自 write）记录计入 max_write_kb，加载时生成的记录由 root 指定，不计入。
+ */
+static int proc_append(struct proc_record *rec, bool charge) {
+    size_t size = struct_size(rec, data, rec->len);
+    u32 id;
+    int ret;
 
-    *pos += count;
-    return count;  // 返回实际读取的字节数
+    if (charge && proc_write_bytes + size > (size_t)READ_ONCE(max_write_kb) << 10) {
+        kfree(rec);
+        return -ENOSPC;
+    }
+    // 行尾的换行符由 show 统一输出，echo 写入时去掉它
+    if (rec->len && rec->data[rec->len - 1] == '\n') {
+        rec->len--;
+    }
+    ret = xa_alloc(&proc_records, &id, rec, xa_limit_32b, GFP_KERNEL);
+    if (ret) {
+        kfree(rec);
+        return ret;
+    }
+    proc_nr_records++;
+    if (charge) {
+        proc_write_bytes += size;
+    }
+    return 0;
 }
 
-// 写入数据到 /proc/procfs_demo 文件
-static ssize_t proc_write(struct file *file, const char __user *user_buf, size_t count, loff_t *pos) {
-    if (count > BUFFER_SIZE) {
-        count = BUFFER_SIZE;  // 限制最大写入数据
+// 写入数据到 /proc/procfs_demo 文件：每次写入追加一条记录，超过 RECORD_MAX 的部分被截断
+static ssize_t proc_do_write(const char __user *user_buf, size_t count) {
+    struct proc_record *rec;
+    int ret;
+
+    if (count > RECORD_MAX) {
+        count = RECORD_MAX;  // 限制最大写入数据
     }
 
-    if (copy_from_user(kernel_buffer, user_buf, count) != 0) {
+    rec = proc_record_alloc(count);
+    if (!rec) {
+        return -ENOMEM;
+    }
+    if (copy_from_user(rec->data, user_buf, count) != 0) {
+        kfree(rec);
         return -EFAULT;  // 复制失败
     }
 
-    data_size = count;
-    kernel_buffer[data_size] = '\0';  // 确保字符串结尾
+    mutex_lock(&proc_write_lock);
+    ret = proc_append(rec, true);
+    mutex_unlock(&proc_write_lock);
+    if (ret) {
+        return ret;
+    }
+
+    u2k_stats_inc(proc_stats, PROC_STAT_WRITE);
+    u2k_stats_add(proc_stats, PROC_STAT_WRITE_BYTES, count);
     return count;  // 返回写入的字节数
 }
 
+static ssize_t proc_write(struct file *file, const char __user *user_buf, size_t count, loff_t *pos) {
+    u64 start;
+    ssize_t ret;
+
+    trace_u2k_proc_enter(true, count, *pos);
+    start = u2k_lat_start();
+    ret = proc_do_write(user_buf, count);
+    u2k_lat_end(proc_lat, PROC_LAT_WRITE, start);
+    trace_u2k_proc_exit(true, ret);
+    return ret;
+}
+
+// 加载时追加一条内核生成的记录
+static int proc_append_str(const char *str) {
+    struct proc_record *rec = proc_record_alloc(strlen(str));
+
+    if (!rec) {
+        return -ENOMEM;
+    }
+    memcpy(rec->data, str, rec->len);
+    return proc_append(rec, false);
+}
+
+static void proc_free_records(void) {
+    struct proc_record *rec;
+    unsigned long id;
+
+    xa_for_each(&proc_records, id, rec) {
+        kfree(rec);
+    }
+    xa_destroy(&proc_records);
+}
+
 // 文件操作结构
 static struct proc_ops proc_fops = {
+    .proc_open = proc_open,
     .proc_read = proc_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release,
     .proc_write = proc_write,
 };
 
 // 初始化内核模块
 static int __init procfs_demo_init(void) {
-    // 分配内核缓冲区
-    kernel_buffer = kmalloc(BUFFER_SIZE, GFP_KERNEL);
-    if (!kernel_buffer) {
-        printk(KERN_ERR "Failed to allocate memory\n");
-        return -ENOMEM;
+    char buf[64];
+    unsigned int i;
+    int ret;
+
+    // 初始记录，以及用于测试大输出的合成记录
+    ret = proc_append_str("Hello from Kernel!");
+    for (i = 0; !ret && i < nr_records; i++) {
+        snprintf(buf, sizeof(buf), "synthetic record %u", i);
+        ret = proc_append_str(buf);
+    }
+    if (ret) {
+        proc_free_records();
+        printk(KERN_ERR "Failed to allocate records\n");
+        return ret;
     }
 
     // 在 /proc 下创建文件
     proc_file = proc_create(PROC_FILENAME, 0666, NULL, &proc_fops);
     if (!proc_file) {
-        kfree(kernel_buffer);
+        proc_free_records();
         printk(KERN_ERR "Failed to create /proc/%s\n", PROC_FILENAME);
         return -ENOMEM;
     }
 
-    // 初始化内核缓冲区内容
-    snprintf(kernel_buffer, BUFFER_SIZE, "Hello from Kernel!");
-    data_size = strlen(kernel_buffer);
+    // 观测失败不影响模块本身，proc_lat 为 NULL 时不记录
+    proc_lat = u2k_lat_register("procfs", proc_lat_names, PROC_LAT_NR);
+    if (IS_ERR(proc_lat)) {
+        printk(KERN_WARNING "Failed to register /proc/u2k/procfs\n");
+        proc_lat = NULL;
+    }
 
-    printk(KERN_INFO "/proc/%s created\n", PROC_FILENAME);
+    printk(KERN_INFO "/proc/%s created with %lu records\n", PROC_FILENAME, proc_nr_records);
     return 0;
 }
 
 // 卸载内核模块
 static void __exit procfs_demo_exit(void) {
-    remove_proc_entry(PROC_FILENAME, NULL);  // 删除 /proc 下的文件
-    kfree(kernel_buffer);  // 释放内核缓冲区
+    u64 stats[PROC_STAT_NR];
+
+    remove_proc_entry(PROC_FILENAME, NULL);  // 删除 /proc 下的文件，等待进行中的读写结束
+    u2k_lat_unregister(proc_lat);
+    u2k_stats_sum(&proc_stats, stats, PROC_STAT_NR);
+    printk(KERN_INFO "/proc/%s: %llu reads (%llu bytes), %llu writes (%llu bytes)\n", PROC_FILENAME,
+           stats[PROC_STAT_READ], stats[PROC_STAT_READ_BYTES], stats[PROC_STAT_WRITE],
+           stats[PROC_STAT_WRITE_BYTES]);
+    proc_free_records();  // 释放所有记录
     printk(KERN_INFO "/proc/%s removed\n", PROC_FILENAME);
 }
 
@@ -3,11 +3,96 @@
 #include <fcntl.h>    // open
 #include <unistd.h>   // close, read, write
 #include <string.h>   // strlen
+#include <stdint.h>
+#include <time.h>
 
 #define PROC_PATH "/proc/procfs_demo"
 
-int main() {
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * 大输出测试：以 chunk 字节为单位把整个文件流式读完，检查每行的序号是否从 0 开始连续递增，
+ * 即跨越 seq_file 分页边界时既没有重复也没有丢失记录。
+ * 然后从文件中间某一行的起始偏移重新 pread / lseek+read，验证续读得到的正是那一行。
+ * 建议以 nr_records=100000 加载模块。
+ */
+static int dump_test(size_t chunk) {
+    char *buf = malloc(chunk + 1), *line = malloc(4096), mid[64] = {0}, again[64] = {0};
+    size_t line_len = 0, total = 0, mid_off = 0;
+    unsigned long long expect = 0, idx, mid_idx = 0;
+    int fd, ret = 0;
+    ssize_t n;
+    uint64_t start;
+
+    fd = open(PROC_PATH, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+
+    start = now_ns();
+    while ((n = read(fd, buf, chunk)) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] != '\n') {
+                if (line_len < 4095) {
+                    line[line_len++] = buf[i];
+                }
+                continue;
+            }
+            line[line_len] = '\0';
+            if (sscanf(line, "%llu", &idx) != 1 || idx != expect) {
+                fprintf(stderr, "record %llu: unexpected line \"%s\"\n", expect, line);
+                ret = -1;
+            }
+            // 记住第 3 页之后第一行的起始偏移与序号，稍后从这里续读
+            if (!mid_off && total + i >= 4096 * 3) {
+                mid_off = total + i + 1;
+                mid_idx = expect + 1;
+            }
+            expect++;
+            line_len = 0;
+        }
+        total += n;
+    }
+    if (n < 0) {
+        perror("read");
+        ret = -1;
+    }
+    printf("dump: %llu records, %zu bytes in %zu-byte reads, %.1f ms\n", expect, total, chunk,
+           (now_ns() - start) / 1e6);
+
+    // 从中间偏移续读：pread 与 lseek+read 都应从序号为 mid_idx 的那一行开始
+    if (mid_off && mid_idx < expect) {
+        if (pread(fd, mid, sizeof(mid) - 1, mid_off) < 0 || lseek(fd, mid_off, SEEK_SET) < 0 ||
+            read(fd, again, sizeof(again) - 1) < 0) {
+            perror("resume");
+            ret = -1;
+        } else if (strcmp(mid, again) != 0 || sscanf(mid, "%llu", &idx) != 1 || idx != mid_idx) {
+            fprintf(stderr, "resume at %zu: expected record %llu, got \"%s\" / \"%s\"\n", mid_off,
+                    mid_idx, mid, again);
+            ret = -1;
+        } else {
+            printf("resume at offset %zu: %.*s\n", mid_off, (int)strcspn(mid, "\n"), mid);
+        }
+    }
+
+    close(fd);
+    free(buf);
+    free(line);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
     int fd;
+
+    // ./user_proc_test dump [每次读取字节数]：流式读取全部记录并校验
+    if (argc > 1 && strcmp(argv[1], "dump") == 0) {
+        return dump_test(argc > 2 ? strtoul(argv[2], NULL, 0) : 4096) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
     char read_buf[1024] = {0};  // 读取缓冲区
     char write_buf[] = "Hello from Userspace!";  // 要写入的数据
 
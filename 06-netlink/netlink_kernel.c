@@ -1,77 +1,681 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
-#include <linux/netlink.h>
-#include <linux/skbuff.h>
-#include <linux/string.h>
-#include <net/sock.h>
-#include <net/net_namespace.h> // 需要包含这个头文件来使用 init_net
-
-#define NETLINK_USER 31  // 定义 Netlink 用户组号
-
-struct sock *nl_sk = NULL;
-
-// Netlink 消息处理函数
-static void netlink_recv_msg(struct sk_buff *skb) {
-    struct nlmsghdr *nlh;
-    char *recv_msg;
-    int num, new_num;
-    char send_msg[32];
-    struct sk_buff *skb_out;
-    int msg_size;
-    int pid;
-    int res;
-
-    nlh = nlmsg_hdr(skb);
-    recv_msg = (char *)NLMSG_DATA(nlh);
-    pr_info("Kernel received: %s\n", recv_msg);
-
-    // 字符串转换为整数
-    if (kstrtoint(recv_msg, 10, &num)) {
-        pr_err("Invalid number format\n");
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/kthread.h>
+#include <linux/delay.h>
+#include <linux/math64.h>
+#include <linux/xarray.h>
+#include <net/genetlink.h>
+#include "u2k_genl.h"  // family 名、命令与属性编号，与用户态共用
+#include "u2k_stats.h"
+#include "u2k_lat.h"   // 延迟直方图（u2k_common.ko）
+#include "u2k_trace.h" // 跟踪点（u2k_common.ko）
+
+/*
+ * generic netlink family U2K_GENL_NAME，family ID 由内核分配，不占用固定的 netlink 协议号。
+ * genetlink 核心负责解析 nlmsghdr/genlmsghdr、按 policy 校验属性、处理 NLM_F_ACK，
+ * 命令处理函数直接从 info->attrs 中取出二进制数值。
+ *
+ * 一次 sendmsg 可以打包任意多条请求，genetlink 通过 netlink_rcv_skb 逐条调用 doit，
+ * 并按 NLM_F_ACK 与错误码回复 NLMSG_ERROR。同一批请求的回复不再每条分配一个 skb，
+ * 而是追加到同一个待发 skb 中（nl_reply_skb），在以下时机一次性发出：
+ *   - 处理完 skb 中的最后一条请求；
+ *   - 请求出错或带 NLM_F_ACK，保证回复先于内核随后发出的 NLMSG_ERROR；
+ *   - 待发 skb 放不下下一条回复，或下一条请求来自另一个 portid。
+ * 回复的 nlmsg_seq 与请求相同，客户端按序号匹配。在 doit 之前就被拒绝的请求（如 policy 校验失败）
+ * 的 NLMSG_ERROR 可能先于同批中更早请求的回复到达。
+ */
+
+// 合并回复的 skb 大小，0 表示每条回复单独发送
+static unsigned int reply_batch_size = NLMSG_GOODSIZE;
+module_param(reply_batch_size, uint, 0644);
+MODULE_PARM_DESC(reply_batch_size, "Bytes of replies coalesced into one skb, 0 = one skb per reply");
+
+/*
+ * 事件生产者：内核线程按 event_rate 向多播组 U2K_GENL_MCGRP_EVENTS 广播 U2K_CMD_EVENT，
+ * 两个参数都可以在运行时修改。没有订阅者时不生成事件；速率超过发送能力时全速发送。
+ */
+static unsigned int event_rate;
+module_param(event_rate, uint, 0644);
+MODULE_PARM_DESC(event_rate, "Multicast events per second, 0 = producer idle");
+
+static unsigned int event_size = 64;
+module_param(event_size, uint, 0644);
+MODULE_PARM_DESC(event_size, "Payload bytes per event, at most U2K_DATA_MAX");
+
+/*
+ * 通过 NLM_F_DUMP 分页读取的表。值直接存为 xarray 的 value entry（xa_mk_value），不需要额外分配，
+ * 因此 VALUE 不能超过 LONG_MAX。nl_table_gen 在每次修改后递增，转储用它检测并发修改。
+ */
+static unsigned int table_size = 1 << 20;
+module_param(table_size, uint, 0444);
+MODULE_PARM_DESC(table_size, "Number of table entries created at load time");
+
+static DEFINE_XARRAY(nl_table);
+
+/*
+ * 单条小回复的 skb 池，每个 CPU 一个。热路径只从本 CPU 的池中取一个现成的 skb，
+ * 取走后池中少于一半时由本 CPU 的 work 在热路径之外补满，分配与初始化的开销不再出现在 doit 中。
+ * skb 发出后由接收方释放，不会回到池中。池用 sk_buff_head 自带的锁保护：
+ * 正常情况下只有本 CPU 的 doit 与 refill 访问，锁没有竞争；doit 取池之后被迁移也不影响正确性。
+ * 加载时只预填在线 CPU 的池，其余 CPU（possible 远多于 online 的机器上可能永远不会上线）
+ * 在第一次处理请求时由同一个 refill 机制补满。pool_size 可以在运行时调整，调小后多出的 skb 在下次取用时被释放。
+ */
+#define NL_POOL_SKB_SIZE 256  // 池中 skb 的 payload 大小，足够 INCR/GET_STATS/表的回复
+
+static unsigned int pool_size = 128;
+module_param(pool_size, uint, 0644);
+MODULE_PARM_DESC(pool_size, "Preallocated reply skbs per CPU, 0 = allocate every reply on demand");
+
+struct nl_skb_pool {
+    struct sk_buff_head skbs;
+    struct work_struct refill;
+};
+static DEFINE_PER_CPU(struct nl_skb_pool, nl_pools);
+static atomic_t nl_table_gen = ATOMIC_INIT(1);  // 从 1 开始：cb->prev_seq 为 0 表示尚未记录
+
+// 消息统计，doit 在发送者的上下文中执行，多个进程并发发送时分布在不同 CPU 上
+enum {
+    NL_STAT_RX,        // 收到的消息数
+    NL_STAT_RX_BYTES,  // 收到的消息字节数（含 nlmsghdr）
+    NL_STAT_TX,        // 成功发送的回复数
+    NL_STAT_TX_SKB,    // 发出的 skb 数，TX / TX_SKB 即平均每个 skb 合并的回复数
+    NL_STAT_TX_ERR,    // 分配或发送失败而丢失的回复数
+    NL_STAT_EV,        // 广播的事件数
+    NL_STAT_EV_DROP,   // 至少一个订阅者接收缓冲区满而丢失的事件数，见 nl_event_send
+    NL_STAT_DUMP,      // 转储发出的记录数
+    NL_STAT_POOL_HIT,  // 回复 skb 取自池
+    NL_STAT_POOL_MISS, // 池为空或回复太大，在热路径上分配
+    NL_STAT_NR,
+};
+static DEFINE_PER_CPU(struct u2k_stats, nl_stats);
+
+// 延迟直方图 /proc/u2k/netlink：每条请求在 doit 中的耗时（含发出积攒的回复），每个命令一行
+enum {
+    NL_LAT_INCR,
+    NL_LAT_ECHO,
+    NL_LAT_STATS,
+    NL_LAT_TABLE,  // 表的单条 get / set / del
+    NL_LAT_DUMP,   // 转储时每次填满一个 skb
+    NL_LAT_NR,
+};
+static const char *const nl_lat_names[NL_LAT_NR] = { "incr", "echo", "stats", "table", "dump" };
+static struct u2k_lat *nl_lat;
+
+// 属性校验规则，类型或长度不符的请求在到达 doit 之前就被拒绝
+static const struct nla_policy u2k_genl_policy[U2K_ATTR_MAX + 1] = {
+    [U2K_ATTR_VALUE] = { .type = NLA_U64 },
+    [U2K_ATTR_DELTA] = { .type = NLA_U32 },
+    [U2K_ATTR_DATA] = { .type = NLA_BINARY, .len = U2K_DATA_MAX },
+    [U2K_ATTR_KEY] = { .type = NLA_U32 },
+};
+
+static struct genl_family u2k_genl_family;
+
+enum {
+    NL_MCGRP_EVENTS,  // 在 family 多播组数组中的下标
+};
+
+static const struct genl_multicast_group u2k_genl_mcgrps[] = {
+    [NL_MCGRP_EVENTS] = { .name = U2K_GENL_MCGRP_EVENTS },
+};
+
+static struct task_struct *nl_event_task;
+
+/*
+ * 待发送的回复，只发往同一个 portid。family 未设置 netnsok，只在 init_net 中可见。
+ * genetlink 对未设置 parallel_ops 的 family 已经串行调用 doit，这里的锁使这部分状态不依赖于此，
+ * 也用于和 nl_flush_work 互斥。
+ */
+static DEFINE_MUTEX(nl_reply_lock);
+static struct sk_buff *nl_reply_skb;
+static u32 nl_reply_portid;
+static unsigned int nl_reply_nr;  // nl_reply_skb 中的回复条数
+static bool nl_reply_more;        // 当前请求之后同一个 skb 中还有请求，由 doit 设置
+
+// 发出待发送的回复，调用者持有 nl_reply_lock
+static void nl_reply_flush(void) {
+    int ret;
+
+    if (!nl_reply_skb) {
+        return;
+    }
+    if (!nl_reply_nr) {  // 唯一的一条回复填写失败被撤销了
+        nlmsg_free(nl_reply_skb);
+        nl_reply_skb = NULL;
         return;
     }
+    ret = genlmsg_unicast(&init_net, nl_reply_skb, nl_reply_portid);  // 失败时会释放 skb
+    if (ret < 0) {
+        u2k_stats_add(nl_stats, NL_STAT_TX_ERR, nl_reply_nr);
+    } else {
+        u2k_stats_add(nl_stats, NL_STAT_TX, nl_reply_nr);
+        u2k_stats_inc(nl_stats, NL_STAT_TX_SKB);
+    }
+    nl_reply_skb = NULL;
+    nl_reply_nr = 0;
+}
 
-    new_num = num + 1;  // 增加 1
-    snprintf(send_msg, sizeof(send_msg), "%d", new_num);  // 将新数字转换为字符串
+/*
+ * 兜底：最后一条请求没有到达 doit 时（被 genetlink 拒绝），积攒的回复由这里发出。
+ * 正常情况下批次的最后一条请求已经发出了所有回复，这里什么也不做。
+ */
+static void nl_flush_work_fn(struct work_struct *work) {
+    mutex_lock(&nl_reply_lock);
+    nl_reply_flush();
+    mutex_unlock(&nl_reply_lock);
+}
+static DECLARE_DELAYED_WORK(nl_flush_work, nl_flush_work_fn);
 
-    msg_size = strlen(send_msg) + 1;
-    pid = nlh->nlmsg_pid;  // 获取发送进程的 PID
+// 把池补到 pool_size 个，pool_size 被调小时释放多出的部分
+static void nl_pool_fill(struct nl_skb_pool *pool) {
+    unsigned int size = READ_ONCE(pool_size);
 
-    skb_out = nlmsg_new(msg_size, GFP_KERNEL);
-    if (!skb_out) {
-        pr_err("Failed to allocate new skb\n");
-        return;
+    while (skb_queue_len(&pool->skbs) > size) {
+        kfree_skb(skb_dequeue(&pool->skbs));
+    }
+    while (skb_queue_len(&pool->skbs) < size) {
+        struct sk_buff *skb = nlmsg_new(NL_POOL_SKB_SIZE, GFP_KERNEL);
+
+        if (!skb) {
+            break;
+        }
+        skb_queue_tail(&pool->skbs, skb);
+        cond_resched();
+    }
+}
+
+static void nl_pool_refill(struct work_struct *work) {
+    nl_pool_fill(container_of(work, struct nl_skb_pool, refill));
+}
+
+// 取一个空 skb，size 与 nlmsg_new() 的参数含义相同：优先取自本 CPU 的池，否则现场分配
+static struct sk_buff *nl_pool_get(size_t size) {
+    int cpu = raw_smp_processor_id();
+    struct nl_skb_pool *pool = per_cpu_ptr(&nl_pools, cpu);
+    unsigned int depth = READ_ONCE(pool_size), len;
+    struct sk_buff *skb = NULL;
+
+    if (size <= NL_POOL_SKB_SIZE) {
+        skb = skb_dequeue(&pool->skbs);
     }
+    len = skb_queue_len(&pool->skbs);
+    if ((depth && len < depth / 2) || len > depth) {
+        schedule_work_on(cpu, &pool->refill);  // 已在排队时只是一次位测试
+    }
+    if (skb) {
+        u2k_stats_inc(nl_stats, NL_STAT_POOL_HIT);
+        return skb;
+    }
+    u2k_stats_inc(nl_stats, NL_STAT_POOL_MISS);
+    return nlmsg_new(size, GFP_KERNEL);
+}
 
-    nlh = nlmsg_put(skb_out, 0, 0, NLMSG_DONE, msg_size, 0);
-    strncpy(NLMSG_DATA(nlh), send_msg, msg_size);  // 复制数据到消息中
+/*
+ * 在待发 skb 中为 info 对应的请求开始一条回复，payload 为属性部分的长度。
+ * 放不下或目标 portid 不同时先发出已有的回复。调用者持有 nl_reply_lock，
+ * 填好属性后调用 nl_reply_end()，失败时调用 genlmsg_cancel()。
+ */
+static void *nl_reply_begin(struct genl_info *info, size_t payload) {
+    size_t need = genlmsg_total_size(payload);
+    void *hdr;
 
-    // 发送数据到用户态
-    res = netlink_unicast(nl_sk, skb_out, pid, MSG_DONTWAIT);
-    if (res < 0) {
-        pr_err("Failed to send response\n");
+    if (nl_reply_skb && (nl_reply_portid != info->snd_portid || skb_tailroom(nl_reply_skb) < nlmsg_total_size(need))) {
+        nl_reply_flush();
+    }
+    if (!nl_reply_skb) {
+        /*
+         * 只有后面还有请求时才按 reply_batch_size 分配。每个 datagram 只有一条请求时（如流水线客户端）
+         * 按实际大小分配，否则每条小回复都占用一个整页的 truesize，很快耗尽对方的接收缓冲区。
+         */
+        if (nl_reply_more) {
+            nl_reply_skb = nlmsg_new(max_t(size_t, need, reply_batch_size), GFP_KERNEL);
+        } else {
+            nl_reply_skb = nl_pool_get(need);
+        }
+        if (!nl_reply_skb) {
+            u2k_stats_inc(nl_stats, NL_STAT_TX_ERR);
+            return NULL;
+        }
+        nl_reply_portid = info->snd_portid;
+    }
+    hdr = genlmsg_put_reply(nl_reply_skb, info, &u2k_genl_family, 0, info->genlhdr->cmd);
+    if (!hdr) {
+        u2k_stats_inc(nl_stats, NL_STAT_TX_ERR);
+    }
+    return hdr;
+}
+
+static void nl_reply_end(void *hdr) {
+    genlmsg_end(nl_reply_skb, hdr);
+    nl_reply_nr++;
+}
+
+/*
+ * doit 收到的 skb 就是 netlink_rcv_skb 正在处理的整个请求 skb，它在每条消息处理完之后才 skb_pull，
+ * 因此 skb->data 指向当前消息，剩余长度不超过当前消息时即为最后一条。
+ */
+static bool nl_last_msg(const struct sk_buff *skb, const struct nlmsghdr *nlh) {
+    return NLMSG_ALIGN(nlh->nlmsg_len) >= skb->len;
+}
+
+// U2K_CMD_INCR：回复 VALUE + DELTA
+static int u2k_genl_incr(struct genl_info *info) {
+    void *hdr;
+    u64 value;
+    u32 delta = 1;
+
+    if (!info->attrs[U2K_ATTR_VALUE]) {
+        GENL_SET_ERR_MSG(info, "missing U2K_ATTR_VALUE");
+        return -EINVAL;
+    }
+    value = nla_get_u64(info->attrs[U2K_ATTR_VALUE]);
+    if (info->attrs[U2K_ATTR_DELTA]) {
+        delta = nla_get_u32(info->attrs[U2K_ATTR_DELTA]);
+    }
+
+    hdr = nl_reply_begin(info, nla_total_size_64bit(sizeof(u64)));
+    if (!hdr) {
+        return -ENOMEM;
+    }
+    if (nla_put_u64_64bit(nl_reply_skb, U2K_ATTR_VALUE, value + delta, U2K_ATTR_PAD)) {
+        genlmsg_cancel(nl_reply_skb, hdr);
+        return -EMSGSIZE;
+    }
+    nl_reply_end(hdr);
+    return 0;
+}
+
+// U2K_CMD_ECHO：原样返回 DATA
+static int u2k_genl_echo(struct genl_info *info) {
+    const struct nlattr *data = info->attrs[U2K_ATTR_DATA];
+    void *hdr;
+
+    if (!data) {
+        GENL_SET_ERR_MSG(info, "missing U2K_ATTR_DATA");
+        return -EINVAL;
+    }
+
+    hdr = nl_reply_begin(info, nla_total_size(nla_len(data)));
+    if (!hdr) {
+        return -ENOMEM;
+    }
+    if (nla_put(nl_reply_skb, U2K_ATTR_DATA, nla_len(data), nla_data(data))) {
+        genlmsg_cancel(nl_reply_skb, hdr);
+        return -EMSGSIZE;
+    }
+    nl_reply_end(hdr);
+    return 0;
+}
+
+// U2K_CMD_GET_STATS：回复事件的广播与丢失计数，以及 skb 池的命中与未命中
+static int u2k_genl_get_stats(struct genl_info *info) {
+    u64 stats[NL_STAT_NR];
+    void *hdr;
+
+    u2k_stats_sum(&nl_stats, stats, NL_STAT_NR);
+    hdr = nl_reply_begin(info, 4 * nla_total_size_64bit(sizeof(u64)));
+    if (!hdr) {
+        return -ENOMEM;
+    }
+    if (nla_put_u64_64bit(nl_reply_skb, U2K_ATTR_EVENTS, stats[NL_STAT_EV], U2K_ATTR_PAD) ||
+        nla_put_u64_64bit(nl_reply_skb, U2K_ATTR_EVENT_DROPS, stats[NL_STAT_EV_DROP], U2K_ATTR_PAD) ||
+        nla_put_u64_64bit(nl_reply_skb, U2K_ATTR_POOL_HITS, stats[NL_STAT_POOL_HIT], U2K_ATTR_PAD) ||
+        nla_put_u64_64bit(nl_reply_skb, U2K_ATTR_POOL_MISSES, stats[NL_STAT_POOL_MISS], U2K_ATTR_PAD)) {
+        genlmsg_cancel(nl_reply_skb, hdr);
+        return -EMSGSIZE;
+    }
+    nl_reply_end(hdr);
+    return 0;
+}
+
+// U2K_CMD_TABLE_GET / SET / DEL 的单条操作，GET 回复 KEY、VALUE
+static int u2k_genl_table(struct genl_info *info) {
+    u8 cmd = info->genlhdr->cmd;
+    void *entry, *hdr;
+    u64 value;
+    u32 key;
+    int ret;
+
+    if (!info->attrs[U2K_ATTR_KEY]) {
+        GENL_SET_ERR_MSG(info, "missing U2K_ATTR_KEY");
+        return -EINVAL;
+    }
+    key = nla_get_u32(info->attrs[U2K_ATTR_KEY]);
+
+    if (cmd == U2K_CMD_TABLE_SET) {
+        if (!info->attrs[U2K_ATTR_VALUE]) {
+            GENL_SET_ERR_MSG(info, "missing U2K_ATTR_VALUE");
+            return -EINVAL;
+        }
+        value = nla_get_u64(info->attrs[U2K_ATTR_VALUE]);
+        if (value > LONG_MAX) {
+            GENL_SET_ERR_MSG(info, "U2K_ATTR_VALUE exceeds INT64_MAX");
+            return -ERANGE;
+        }
+        ret = xa_err(xa_store(&nl_table, key, xa_mk_value(value), GFP_KERNEL));
+        if (!ret) {
+            atomic_inc(&nl_table_gen);
+        }
+        return ret;
+    }
+    if (cmd == U2K_CMD_TABLE_DEL) {
+        if (!xa_erase(&nl_table, key)) {
+            return -ENOENT;
+        }
+        atomic_inc(&nl_table_gen);
+        return 0;
+    }
+
+    entry = xa_load(&nl_table, key);
+    if (!entry) {
+        return -ENOENT;
+    }
+    hdr = nl_reply_begin(info, nla_total_size(sizeof(u32)) + nla_total_size_64bit(sizeof(u64)));
+    if (!hdr) {
+        return -ENOMEM;
+    }
+    if (nla_put_u32(nl_reply_skb, U2K_ATTR_KEY, key) ||
+        nla_put_u64_64bit(nl_reply_skb, U2K_ATTR_VALUE, xa_to_value(entry), U2K_ATTR_PAD)) {
+        genlmsg_cancel(nl_reply_skb, hdr);
+        return -EMSGSIZE;
+    }
+    nl_reply_end(hdr);
+    return 0;
+}
+
+// 所有命令共用的入口：版本检查、统计、延迟与跟踪，然后按命令分发
+static int u2k_genl_doit(struct sk_buff *skb, struct genl_info *info) {
+    u32 portid = info->snd_portid;
+    u8 cmd = info->genlhdr->cmd;
+    int lat_op = NL_LAT_TABLE;
+    u64 start;
+    int ret;
+
+    u2k_stats_inc(nl_stats, NL_STAT_RX);
+    u2k_stats_add(nl_stats, NL_STAT_RX_BYTES, info->nlhdr->nlmsg_len);
+    trace_u2k_netlink_enter(portid, info->nlhdr->nlmsg_len);
+    start = u2k_lat_start();
+
+    mutex_lock(&nl_reply_lock);
+    nl_reply_more = reply_batch_size && !nl_last_msg(skb, info->nlhdr);
+    if (info->genlhdr->version > U2K_GENL_VERSION) {
+        GENL_SET_ERR_MSG(info, "unsupported " U2K_GENL_NAME " version");
+        ret = -EOPNOTSUPP;
+    } else if (cmd == U2K_CMD_INCR) {
+        lat_op = NL_LAT_INCR;
+        ret = u2k_genl_incr(info);
+    } else if (cmd == U2K_CMD_ECHO) {
+        lat_op = NL_LAT_ECHO;
+        ret = u2k_genl_echo(info);
+    } else if (cmd == U2K_CMD_GET_STATS) {
+        lat_op = NL_LAT_STATS;
+        ret = u2k_genl_get_stats(info);
+    } else {
+        ret = u2k_genl_table(info);
+    }
+    if (ret || !nl_reply_more || (info->nlhdr->nlmsg_flags & NLM_F_ACK)) {
+        nl_reply_flush();
+    } else {
+        schedule_delayed_work(&nl_flush_work, 1);  // 已在排队时只是一次位测试
+    }
+    mutex_unlock(&nl_reply_lock);
+
+    u2k_lat_end(nl_lat, lat_op, start);
+    trace_u2k_netlink_exit(portid, ret);
+    return ret;
+}
+
+/*
+ * NLM_F_DUMP 的 U2K_CMD_TABLE_GET。genetlink 通过 netlink_dump_start 发起转储，
+ * 之后每当用户态读走数据、接收缓冲区有空间时再次调用本函数填充一个新的 skb
+ * （大小随用户态 recvmsg 的缓冲区增长，最大约 32KB），直到返回 0 时发送 NLMSG_DONE。
+ * 游标 cb->args[0] 是下一个要发送的 KEY，按键恢复而不是按位置恢复，
+ * 因此两次调用之间表的插入和删除不会导致重复或跳过未修改的记录。
+ */
+static int u2k_genl_dump_table(struct sk_buff *skb, struct netlink_callback *cb) {
+    u32 portid = NETLINK_CB(cb->skb).portid;
+    unsigned long key = cb->args[0];
+    unsigned int nr = 0;
+    void *entry;
+    u64 start;
+
+    trace_u2k_netlink_enter(portid, cb->nlh->nlmsg_len);
+    start = u2k_lat_start();
+
+    cb->seq = atomic_read(&nl_table_gen);
+    for (entry = xa_find(&nl_table, &key, ULONG_MAX, XA_PRESENT); entry;
+         entry = xa_find_after(&nl_table, &key, ULONG_MAX, XA_PRESENT)) {
+        void *hdr = genlmsg_put(skb, portid, cb->nlh->nlmsg_seq, &u2k_genl_family, NLM_F_MULTI, U2K_CMD_TABLE_GET);
+
+        if (!hdr) {
+            break;  // skb 已满，下次从 key 继续
+        }
+        genl_dump_check_consistent(cb, hdr);  // 与上一个 skb 的 cb->seq 不同时设置 NLM_F_DUMP_INTR
+        if (nla_put_u32(skb, U2K_ATTR_KEY, key) ||
+            nla_put_u64_64bit(skb, U2K_ATTR_VALUE, xa_to_value(entry), U2K_ATTR_PAD)) {
+            genlmsg_cancel(skb, hdr);
+            break;
+        }
+        genlmsg_end(skb, hdr);
+        cb->args[0] = key + 1;
+        nr++;
+    }
+
+    u2k_stats_add(nl_stats, NL_STAT_DUMP, nr);
+    u2k_lat_end(nl_lat, NL_LAT_DUMP, start);
+    trace_u2k_netlink_exit(portid, skb->len);
+    return skb->len;
+}
+
+static const struct genl_ops u2k_genl_ops[] = {
+    {
+        .cmd = U2K_CMD_INCR,
+        .doit = u2k_genl_doit,
+    },
+    {
+        .cmd = U2K_CMD_ECHO,
+        .doit = u2k_genl_doit,
+    },
+    {
+        .cmd = U2K_CMD_GET_STATS,
+        .doit = u2k_genl_doit,
+    },
+    {
+        .cmd = U2K_CMD_TABLE_GET,
+        .doit = u2k_genl_doit,
+        .dumpit = u2k_genl_dump_table,
+    },
+    // 修改表需要 CAP_NET_ADMIN：键可以是任意 u32，否则普通用户就能让表无限增长
+    {
+        .cmd = U2K_CMD_TABLE_SET,
+        .doit = u2k_genl_doit,
+        .flags = GENL_ADMIN_PERM,
+    },
+    {
+        .cmd = U2K_CMD_TABLE_DEL,
+        .doit = u2k_genl_doit,
+        .flags = GENL_ADMIN_PERM,
+    },
+};
+
+static struct genl_family u2k_genl_family = {
+        .name = U2K_GENL_NAME,
+        .version = U2K_GENL_VERSION,
+        .maxattr = U2K_ATTR_MAX,
+        .policy = u2k_genl_policy,
+        .module = THIS_MODULE,
+        .ops = u2k_genl_ops,
+        .n_ops = ARRAY_SIZE(u2k_genl_ops),
+        .mcgrps = u2k_genl_mcgrps,
+        .n_mcgrps = ARRAY_SIZE(u2k_genl_mcgrps),
+        // resv_start_op 保持 0：新 family 的所有命令都做严格校验，拒绝未知属性和非零的保留字段
+};
+
+// 构造并广播一个事件，返回 genlmsg_multicast 的结果
+static int nl_event_send(u64 seq, unsigned int size) {
+    struct sk_buff *skb;
+    struct nlattr *data;
+    void *hdr;
+
+    skb = genlmsg_new(2 * nla_total_size_64bit(sizeof(u64)) + nla_total_size(size), GFP_KERNEL);
+    if (!skb) {
+        return -ENOMEM;
+    }
+    hdr = genlmsg_put(skb, 0, 0, &u2k_genl_family, 0, U2K_CMD_EVENT);
+    if (!hdr || nla_put_u64_64bit(skb, U2K_ATTR_EVENT_SEQ, seq, U2K_ATTR_PAD) ||
+        nla_put_u64_64bit(skb, U2K_ATTR_TIMESTAMP, ktime_get_ns(), U2K_ATTR_PAD)) {
+        goto fail;
+    }
+    data = nla_reserve(skb, U2K_ATTR_DATA, size);
+    if (!data) {
+        goto fail;
+    }
+    memset(nla_data(data), (u8)seq, size);
+    genlmsg_end(skb, hdr);
+    /*
+     * netlink_broadcast 只对设置了 NETLINK_BROADCAST_ERROR 的订阅者报告接收队列满（-ENOBUFS），
+     * 其余订阅者照常收到；未设置该选项的订阅者溢出时，只要还有别人收到就返回 0，
+     * 一个都没有收到则返回 -ESRCH（与没有订阅者相同）。
+     */
+    return genlmsg_multicast(&u2k_genl_family, skb, 0, NL_MCGRP_EVENTS, GFP_KERNEL);
+
+fail:
+    nlmsg_free(skb);
+    return -EMSGSIZE;
+}
+
+/*
+ * 每个周期（约 1ms）按当前速率生效以来的时间算出应发出的事件数并补齐，
+ * 高速率下一个周期发出一批事件，不需要微秒级的睡眠。速率改变或暂停后重新计时。
+ */
+static int nl_event_thread(void *arg) {
+    unsigned int rate = 0;
+    u64 seq = 0, sent = 0, t0 = 0;
+
+    while (!kthread_should_stop()) {
+        unsigned int new_rate = READ_ONCE(event_rate);
+        u64 due;
+
+        if (!new_rate || !genl_has_listeners(&u2k_genl_family, &init_net, NL_MCGRP_EVENTS)) {
+            rate = 0;
+            msleep(100);
+            continue;
+        }
+        if (new_rate != rate) {
+            rate = new_rate;
+            t0 = ktime_get_ns();
+            sent = 0;
+        }
+
+        due = mul_u64_u32_div(ktime_get_ns() - t0, rate, NSEC_PER_SEC);
+        while (sent < due && !kthread_should_stop()) {
+            int ret = nl_event_send(seq++, min_t(unsigned int, READ_ONCE(event_size), U2K_DATA_MAX));
+
+            if (!ret) {
+                u2k_stats_inc(nl_stats, NL_STAT_EV);
+            } else if (ret == -ENOBUFS ||
+                       (ret == -ESRCH && genl_has_listeners(&u2k_genl_family, &init_net, NL_MCGRP_EVENTS))) {
+                // 有订阅者却没有人收到，同样计为丢失
+                u2k_stats_inc(nl_stats, NL_STAT_EV);
+                u2k_stats_inc(nl_stats, NL_STAT_EV_DROP);
+            }
+            sent++;
+            cond_resched();
+        }
+        usleep_range(1000, 1100);
+    }
+    return 0;
+}
+
+static void nl_pool_destroy(void) {
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        struct nl_skb_pool *pool = per_cpu_ptr(&nl_pools, cpu);
+
+        cancel_work_sync(&pool->refill);
+        skb_queue_purge(&pool->skbs);
     }
 }
 
 // 初始化 Netlink
 static int __init netlink_init(void) {
-    struct netlink_kernel_cfg cfg = {
-            .input = netlink_recv_msg,  // 注册消息接收处理函数
-    };
+    unsigned int i;
+    int cpu, ret;
 
-    nl_sk = netlink_kernel_create(&init_net, NETLINK_USER, &cfg);
-    if (!nl_sk) {
-        pr_err("Failed to create Netlink socket\n");
-        return -ENOMEM;
+    for_each_possible_cpu(cpu) {
+        struct nl_skb_pool *pool = per_cpu_ptr(&nl_pools, cpu);
+
+        skb_queue_head_init(&pool->skbs);
+        INIT_WORK(&pool->refill, nl_pool_refill);
+    }
+    // 只预填在线 CPU；不足时由热路径触发补充，不作为加载失败
+    for_each_online_cpu(cpu) {
+        nl_pool_fill(per_cpu_ptr(&nl_pools, cpu));
+    }
+
+    // 初始表：KEY = VALUE = 0..table_size-1
+    for (i = 0; i < table_size; i++) {
+        ret = xa_err(xa_store(&nl_table, i, xa_mk_value(i), GFP_KERNEL));
+        if (ret) {
+            xa_destroy(&nl_table);
+            nl_pool_destroy();
+            pr_err("Failed to allocate the table\n");
+            return ret;
+        }
+        cond_resched();
     }
 
-    pr_info("Netlink kernel module loaded\n");
+    ret = genl_register_family(&u2k_genl_family);
+    if (ret) {
+        xa_destroy(&nl_table);
+        nl_pool_destroy();
+        pr_err("Failed to register generic netlink family %s\n", U2K_GENL_NAME);
+        return ret;
+    }
+
+    // 观测失败不影响模块本身，nl_lat 为 NULL 时不记录
+    nl_lat = u2k_lat_register("netlink", nl_lat_names, NL_LAT_NR);
+    if (IS_ERR(nl_lat)) {
+        pr_warn("Failed to register /proc/u2k/netlink\n");
+        nl_lat = NULL;
+    }
+
+    nl_event_task = kthread_run(nl_event_thread, NULL, "u2k_nl_event");
+    if (IS_ERR(nl_event_task)) {
+        pr_warn("Failed to start the event producer\n");
+        nl_event_task = NULL;
+    }
+
+    pr_info("Netlink kernel module loaded, family %s id %u\n", U2K_GENL_NAME, u2k_genl_family.id);
     return 0;
 }
 
 // 卸载 Netlink
 static void __exit netlink_exit(void) {
-    netlink_kernel_release(nl_sk);
+    u64 stats[NL_STAT_NR];
+
+    if (nl_event_task) {
+        kthread_stop(nl_event_task);  // 生产者使用 family，先于注销停止
+    }
+    genl_unregister_family(&u2k_genl_family);  // 等待正在执行的 doit 结束，进行中的转储持有模块引用
+    cancel_delayed_work_sync(&nl_flush_work);
+    mutex_lock(&nl_reply_lock);
+    nl_reply_flush();
+    mutex_unlock(&nl_reply_lock);
+    nl_pool_destroy();
+    u2k_lat_unregister(nl_lat);
+    u2k_stats_sum(&nl_stats, stats, NL_STAT_NR);
+    pr_info("Netlink: %llu messages received (%llu bytes), %llu replies sent in %llu skbs, %llu replies lost\n",
+            stats[NL_STAT_RX], stats[NL_STAT_RX_BYTES], stats[NL_STAT_TX], stats[NL_STAT_TX_SKB],
+            stats[NL_STAT_TX_ERR]);
+    pr_info("Netlink: %llu events broadcast, %llu dropped by a full subscriber\n", stats[NL_STAT_EV],
+            stats[NL_STAT_EV_DROP]);
+    pr_info("Netlink: %llu table entries dumped, reply skb pool %llu hits / %llu misses\n", stats[NL_STAT_DUMP],
+            stats[NL_STAT_POOL_HIT], stats[NL_STAT_POOL_MISS]);
+    xa_destroy(&nl_table);  // 只有 value entry，不需要逐个释放
     pr_info("Netlink kernel module unloaded\n");
 }
 
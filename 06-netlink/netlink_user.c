@@ -1,82 +1,860 @@
+#define _GNU_SOURCE  // sendmmsg / recvmmsg
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <signal.h>
 #include <linux/netlink.h>
+#include <linux/genetlink.h>
 #include <unistd.h>
 
-#define NETLINK_USER 31
-#define MAX_PAYLOAD 1024  // Buffer size
+#include "u2k_genl.h"
 
-int main() {
-    struct sockaddr_nl src_addr, dest_addr;
-    struct nlmsghdr *nlh;
-    struct iovec iov;
-    struct msghdr msg;
-    int sock_fd;
-    char send_buf[32];
+/*
+ * generic netlink 客户端，不依赖 libnl：
+ *   1. 通过 nlctrl（GENL_ID_CTRL）的 CTRL_CMD_GETFAMILY 按名字解析 family ID；
+ *   2. 手工构造 nlmsghdr + genlmsghdr + NLA 属性发送请求；
+ *   3. 解析回复中的属性，NLMSG_ERROR 转换为 errno。
+ *
+ * 用法：
+ *   ./netlink_user [value]        INCR 与 ECHO 各一次
+ *   ./netlink_user batch [total]  每次 sendmsg 打包 1..1024 条 INCR，按序号匹配回复，比较吞吐
+ *   ./netlink_user listen [seconds] [rcvbuf_kb]
+ *                                 订阅事件多播组，每秒报告收到、丢失（序号缺口）的事件数、
+ *                                 ENOBUFS 次数与投递延迟；事件速率由内核模块参数 event_rate 控制
+ *   ./netlink_user dump [churn]   用 NLM_F_DUMP 读出整张表，报告每秒记录数；
+ *                                 churn 时子进程在转储期间不停地修改表（需要 root）
+ *   ./netlink_user pipeline [total]
+ *                                 保持 1..256 条未完成的 INCR，用 sendmmsg/recvmmsg 批量收发，
+ *                                 报告每个窗口大小的吞吐、p50/p99/p999 延迟与回复 skb 池的命中情况
+ */
 
-    // 创建 Netlink socket
-    sock_fd = socket(PF_NETLINK, SOCK_RAW, NETLINK_USER);
-    if (sock_fd < 0) {
-        perror("socket");
+#define MAX_PAYLOAD 4096  // 单条消息的缓冲区大小
+#define BATCH_MAX 1024    // batch 模式单次 sendmsg 的最大请求数
+#define BATCH_TOTAL 1000000
+#define RCVBUF_SIZE (4 << 20)
+#define LISTEN_SECS 10
+#define PIPE_WINDOW_MAX 256  // 2 的幂，序号按它取模映射到预分配的请求槽
+#define PIPE_TOTAL 200000
+#define PIPE_MMSG 64         // 单次 sendmmsg / recvmmsg 的最大消息数
+#define PIPE_REQ_SIZE 64     // 一条 INCR 请求的缓冲区大小
+#define PIPE_RBUF_SIZE 8192  // 每个接收缓冲区的大小，容纳合并后的回复
+
+struct genl_msg {
+    struct nlmsghdr nlh;
+    struct genlmsghdr gnlh;
+    char attrs[MAX_PAYLOAD];
+};
+
+#define GENL_ATTRS(nlh) ((struct nlattr *)((char *)NLMSG_DATA(nlh) + GENL_HDRLEN))
+#define NLA_DATA(nla) ((void *)((char *)(nla) + NLA_HDRLEN))
+
+static uint32_t seq_next = 1;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// 在 nlh 处初始化一条请求的 nlmsghdr 与 genlmsghdr，返回分配的序号
+static uint32_t genl_init(struct nlmsghdr *nlh, uint16_t family, uint8_t cmd, uint8_t version) {
+    struct genlmsghdr *gnlh = NLMSG_DATA(nlh);
+
+    memset(nlh, 0, NLMSG_LENGTH(GENL_HDRLEN));
+    nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    nlh->nlmsg_type = family;
+    nlh->nlmsg_flags = NLM_F_REQUEST;
+    nlh->nlmsg_seq = seq_next++;
+    gnlh->cmd = cmd;
+    gnlh->version = version;
+    return nlh->nlmsg_seq;
+}
+
+// 在消息末尾追加一个属性
+static void genl_put(struct nlmsghdr *nlh, uint16_t type, const void *data, size_t len) {
+    struct nlattr *nla = (struct nlattr *)((char *)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+
+    nla->nla_type = type;
+    nla->nla_len = NLA_HDRLEN + len;
+    memcpy(NLA_DATA(nla), data, len);
+    nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + NLA_ALIGN(nla->nla_len);
+}
+
+// 在从 nla 开始、长 rem 字节的属性流中查找指定类型的属性，找不到返回 NULL
+static struct nlattr *nla_find(struct nlattr *nla, int rem, uint16_t type) {
+    while (rem >= NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN && nla->nla_len <= rem) {
+        if ((nla->nla_type & NLA_TYPE_MASK) == type) {
+            return nla;
+        }
+        rem -= NLA_ALIGN(nla->nla_len);
+        nla = (struct nlattr *)((char *)nla + NLA_ALIGN(nla->nla_len));
+    }
+    return NULL;
+}
+
+// 在回复中查找指定类型的属性，找不到返回 NULL
+static struct nlattr *genl_find(struct nlmsghdr *nlh, uint16_t type) {
+    return nla_find(GENL_ATTRS(nlh), (int)nlh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN), type);
+}
+
+static uint64_t nla_get_u64(const struct nlattr *nla) {
+    uint64_t v;
+
+    memcpy(&v, NLA_DATA(nla), sizeof(v));  // u64 属性可能只按 4 字节对齐
+    return v;
+}
+
+// 发送 len 字节，其中可以包含任意多条首尾相接的请求
+static int genl_send(int fd, const void *buf, size_t len) {
+    struct sockaddr_nl dest_addr = { .nl_family = AF_NETLINK };  // nl_pid = 0：发送到内核
+
+    if (sendto(fd, buf, len, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr)) < 0) {
+        perror("sendto");
         return -1;
     }
+    return 0;
+}
+
+// 接收一条回复，成功返回 0，内核返回错误时返回负的 errno
+static int genl_recv(int fd, struct genl_msg *msg) {
+    ssize_t len = recv(fd, msg, sizeof(*msg), 0);
+
+    if (len < 0) {
+        perror("recv");
+        return -errno;
+    }
+    if (!NLMSG_OK(&msg->nlh, len)) {
+        fprintf(stderr, "truncated netlink message\n");
+        return -EBADMSG;
+    }
+    if (msg->nlh.nlmsg_type == NLMSG_ERROR) {
+        struct nlmsgerr *err = NLMSG_DATA(&msg->nlh);
+
+        return err->error;
+    }
+    return 0;
+}
+
+/*
+ * 通过 nlctrl 解析 family ID，失败返回负的 errno。
+ * grp 不为 NULL 时同时在 CTRL_ATTR_MCAST_GROUPS 中查找该多播组，把组 ID 写入 *grp_id。
+ */
+static int genl_resolve(int fd, const char *name, const char *grp, uint32_t *grp_id) {
+    struct genl_msg msg;
+    struct nlattr *nla;
+    int ret;
+
+    genl_init(&msg.nlh, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 1);
+    genl_put(&msg.nlh, CTRL_ATTR_FAMILY_NAME, name, strlen(name) + 1);
+    if (genl_send(fd, &msg, msg.nlh.nlmsg_len) < 0) {
+        return -EIO;
+    }
+    ret = genl_recv(fd, &msg);
+    if (ret < 0) {
+        return ret;
+    }
+    nla = genl_find(&msg.nlh, CTRL_ATTR_FAMILY_ID);
+    if (!nla) {
+        return -ENOENT;
+    }
+    if (grp) {
+        struct nlattr *groups = genl_find(&msg.nlh, CTRL_ATTR_MCAST_GROUPS);
+        struct nlattr *entry;
+        int rem;
+
+        if (!groups) {
+            return -ENOENT;
+        }
+        // 嵌套属性：每个组是一个嵌套的 { CTRL_ATTR_MCAST_GRP_NAME, CTRL_ATTR_MCAST_GRP_ID }
+        entry = NLA_DATA(groups);
+        rem = groups->nla_len - NLA_HDRLEN;
+        while (rem >= NLA_HDRLEN && entry->nla_len >= NLA_HDRLEN && entry->nla_len <= rem) {
+            struct nlattr *gname = nla_find(NLA_DATA(entry), entry->nla_len - NLA_HDRLEN, CTRL_ATTR_MCAST_GRP_NAME);
+            struct nlattr *gid = nla_find(NLA_DATA(entry), entry->nla_len - NLA_HDRLEN, CTRL_ATTR_MCAST_GRP_ID);
+
+            if (gname && gid && strcmp(NLA_DATA(gname), grp) == 0) {
+                *grp_id = *(uint32_t *)NLA_DATA(gid);
+                return *(uint16_t *)NLA_DATA(nla);
+            }
+            rem -= NLA_ALIGN(entry->nla_len);
+            entry = (struct nlattr *)((char *)entry + NLA_ALIGN(entry->nla_len));
+        }
+        return -ENOENT;
+    }
+    return *(uint16_t *)NLA_DATA(nla);
+}
+
+// 设置接收缓冲区：root 可以用 SO_RCVBUFFORCE 超过 net.core.rmem_max，否则退回 SO_RCVBUF
+static void set_rcvbuf(int fd, int bytes) {
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &bytes, sizeof(bytes)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+    }
+}
 
-    memset(&src_addr, 0, sizeof(src_addr));
-    src_addr.nl_family = AF_NETLINK;
-    src_addr.nl_pid = getpid();  // 本进程的 PID
-    src_addr.nl_groups = 0;      // 单播
+// 创建 generic netlink socket，portid 由内核分配
+static int genl_open(void) {
+    struct sockaddr_nl src_addr = { .nl_family = AF_NETLINK };  // nl_pid = 0：由内核分配 portid
+    int fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
 
-    if (bind(sock_fd, (struct sockaddr *)&src_addr, sizeof(src_addr)) < 0) {
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&src_addr, sizeof(src_addr)) < 0) {
         perror("bind");
-        close(sock_fd);
+        close(fd);
         return -1;
     }
+    return fd;
+}
+
+// U2K_CMD_INCR：返回 value + delta
+static int u2k_incr(int fd, uint16_t family, uint64_t value, uint32_t delta, uint64_t *out) {
+    struct genl_msg msg;
+    struct nlattr *nla;
+    int ret;
+
+    genl_init(&msg.nlh, family, U2K_CMD_INCR, U2K_GENL_VERSION);
+    genl_put(&msg.nlh, U2K_ATTR_VALUE, &value, sizeof(value));
+    genl_put(&msg.nlh, U2K_ATTR_DELTA, &delta, sizeof(delta));
+    if (genl_send(fd, &msg, msg.nlh.nlmsg_len) < 0) {
+        return -EIO;
+    }
+    ret = genl_recv(fd, &msg);
+    if (ret < 0) {
+        return ret;
+    }
+    nla = genl_find(&msg.nlh, U2K_ATTR_VALUE);
+    if (!nla || nla->nla_len != NLA_HDRLEN + sizeof(*out)) {
+        return -EBADMSG;
+    }
+    *out = nla_get_u64(nla);
+    return 0;
+}
+
+// U2K_CMD_ECHO：发送 len 字节，回复写入 out，返回回复的长度
+static int u2k_echo(int fd, uint16_t family, const void *data, size_t len, void *out) {
+    struct genl_msg msg;
+    struct nlattr *nla;
+    int ret;
+
+    genl_init(&msg.nlh, family, U2K_CMD_ECHO, U2K_GENL_VERSION);
+    genl_put(&msg.nlh, U2K_ATTR_DATA, data, len);
+    if (genl_send(fd, &msg, msg.nlh.nlmsg_len) < 0) {
+        return -EIO;
+    }
+    ret = genl_recv(fd, &msg);
+    if (ret < 0) {
+        return ret;
+    }
+    nla = genl_find(&msg.nlh, U2K_ATTR_DATA);
+    if (!nla) {
+        return -EBADMSG;
+    }
+    memcpy(out, NLA_DATA(nla), nla->nla_len - NLA_HDRLEN);
+    return nla->nla_len - NLA_HDRLEN;
+}
+
+/*
+ * 发送 INCR x3 + 带 NLM_F_ACK 的 INCR，检查 4 条回复与 ACK 按顺序到达：
+ * 带 NLM_F_ACK 的请求会让内核先发出积攒的回复，再发送 NLMSG_ERROR(0)。
+ */
+static int ack_test(int fd, uint16_t family) {
+    static char buf[MAX_PAYLOAD];
+    struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+    size_t len = 0;
+    uint32_t first = 0, expect;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        uint64_t value = i;
+        uint32_t seq;
+
+        nlh = (struct nlmsghdr *)(buf + len);
+        seq = genl_init(nlh, family, U2K_CMD_INCR, U2K_GENL_VERSION);
+        genl_put(nlh, U2K_ATTR_VALUE, &value, sizeof(value));
+        if (i == 0) {
+            first = seq;
+        }
+        len += NLMSG_ALIGN(nlh->nlmsg_len);
+    }
+    nlh->nlmsg_flags |= NLM_F_ACK;
+    if (genl_send(fd, buf, len) < 0) {
+        return -1;
+    }
+
+    // 期望的序号：first..first+3 的回复，然后是 first+3 的 ACK
+    expect = first;
+    while (expect <= first + 4) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+        if (n < 0) {
+            perror("recv");
+            return -1;
+        }
+        for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, n); nlh = NLMSG_NEXT(nlh, n)) {
+            int is_ack = nlh->nlmsg_type == NLMSG_ERROR;
+
+            if (is_ack != (expect == first + 4) || nlh->nlmsg_seq != (is_ack ? first + 3 : expect)) {
+                fprintf(stderr, "ack test: unexpected %s seq %u\n", is_ack ? "ack" : "reply", nlh->nlmsg_seq);
+                return -1;
+            }
+            if (is_ack && ((struct nlmsgerr *)NLMSG_DATA(nlh))->error) {
+                fprintf(stderr, "ack test: error %d\n", ((struct nlmsgerr *)NLMSG_DATA(nlh))->error);
+                return -1;
+            }
+            expect++;
+        }
+    }
+    printf("ack test: 4 replies followed by ACK, in order\n");
+    return 0;
+}
+
+/*
+ * 每次 sendmsg 打包 batch 条 INCR（VALUE = 请求编号），然后接收直到凑齐 batch 条回复，
+ * 按序号检查每条回复的值并打印吞吐，出错返回 -1。
+ */
+static int batch_bench(int fd, uint16_t family, int batch, long total) {
+    static char sbuf[BATCH_MAX * 64], rbuf[1 << 18];
+    long done, recvs = 0;
+    uint64_t start = now_ns();
+
+    for (done = 0; done + batch <= total; done += batch) {
+        uint32_t first = 0;
+        size_t len = 0;
+        int i, got = 0;
+
+        for (i = 0; i < batch; i++) {
+            struct nlmsghdr *nlh = (struct nlmsghdr *)(sbuf + len);
+            uint64_t value = done + i;
+            uint32_t seq = genl_init(nlh, family, U2K_CMD_INCR, U2K_GENL_VERSION);
+
+            genl_put(nlh, U2K_ATTR_VALUE, &value, sizeof(value));
+            if (i == 0) {
+                first = seq;
+            }
+            len += NLMSG_ALIGN(nlh->nlmsg_len);
+        }
+        if (genl_send(fd, sbuf, len) < 0) {
+            return -1;
+        }
+
+        while (got < batch) {
+            ssize_t n = recv(fd, rbuf, sizeof(rbuf), 0);
+            struct nlmsghdr *nlh;
+
+            if (n < 0) {
+                // ENOBUFS：回复超出了接收缓冲区被内核丢弃
+                perror("recv");
+                return -1;
+            }
+            recvs++;
+            for (nlh = (struct nlmsghdr *)rbuf; NLMSG_OK(nlh, n); nlh = NLMSG_NEXT(nlh, n)) {
+                uint32_t idx = nlh->nlmsg_seq - first;
+                struct nlattr *nla;
+                uint64_t value;
+
+                if (nlh->nlmsg_type == NLMSG_ERROR) {
+                    fprintf(stderr, "seq %u: %s\n", nlh->nlmsg_seq,
+                            strerror(-((struct nlmsgerr *)NLMSG_DATA(nlh))->error));
+                    return -1;
+                }
+                nla = genl_find(nlh, U2K_ATTR_VALUE);
+                if (idx >= (uint32_t)batch || !nla) {
+                    fprintf(stderr, "unexpected reply seq %u\n", nlh->nlmsg_seq);
+                    return -1;
+                }
+                value = nla_get_u64(nla);
+                if (value != (uint64_t)(done + idx + 1)) {
+                    fprintf(stderr, "seq %u: got %llu, want %ld\n", nlh->nlmsg_seq, (unsigned long long)value,
+                            done + idx + 1);
+                    return -1;
+                }
+                got++;
+            }
+        }
+    }
+    printf("batch %-6d %12.0f req/s  %6.1f replies/recv\n", batch, done / ((now_ns() - start) / 1e9),
+           recvs ? (double)done / recvs : 0.0);
+    return 0;
+}
+
+// U2K_CMD_GET_STATS 返回的内核计数
+struct u2k_kstats {
+    uint64_t events;       // 已广播的事件数
+    uint64_t drops;        // 因订阅者缓冲区满而丢失的事件数
+    uint64_t pool_hits;    // 回复 skb 取自预分配池
+    uint64_t pool_misses;  // 回复 skb 在热路径上分配
+};
+
+static int u2k_get_stats(int fd, uint16_t family, struct u2k_kstats *st) {
+    static const uint16_t types[] = { U2K_ATTR_EVENTS, U2K_ATTR_EVENT_DROPS, U2K_ATTR_POOL_HITS, U2K_ATTR_POOL_MISSES };
+    uint64_t *out[] = { &st->events, &st->drops, &st->pool_hits, &st->pool_misses };
+    struct genl_msg msg;
+    unsigned int i;
+    int ret;
+
+    genl_init(&msg.nlh, family, U2K_CMD_GET_STATS, U2K_GENL_VERSION);
+    if (genl_send(fd, &msg, msg.nlh.nlmsg_len) < 0) {
+        return -EIO;
+    }
+    ret = genl_recv(fd, &msg);
+    if (ret < 0) {
+        return ret;
+    }
+    for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        struct nlattr *nla = genl_find(&msg.nlh, types[i]);
 
-    memset(&dest_addr, 0, sizeof(dest_addr));
-    dest_addr.nl_family = AF_NETLINK;
-    dest_addr.nl_pid = 0;  // 发送到内核
-    dest_addr.nl_groups = 0;
-
-    nlh = (struct nlmsghdr *)malloc(NLMSG_SPACE(MAX_PAYLOAD));
-    memset(nlh, 0, NLMSG_SPACE(MAX_PAYLOAD));
-    nlh->nlmsg_len = NLMSG_SPACE(MAX_PAYLOAD);
-    nlh->nlmsg_pid = getpid();
-    nlh->nlmsg_flags = 0;
-
-    // 发送数据
-    snprintf(send_buf, sizeof(send_buf), "123");  // 发送整数 123
-    strcpy(NLMSG_DATA(nlh), send_buf);
-
-    iov.iov_base = (void *)nlh;
-    iov.iov_len = nlh->nlmsg_len;
-    msg.msg_name = (void *)&dest_addr;
-    msg.msg_namelen = sizeof(dest_addr);
-    msg.msg_iov = &iov;
-    msg.msg_iovlen = 1;
-
-    printf("Sending message to kernel: %s\n", send_buf);
-    if (sendmsg(sock_fd, &msg, 0) < 0) {
-        perror("sendmsg failed");
-        free(nlh);
+        if (!nla) {
+            return -EBADMSG;
+        }
+        *out[i] = nla_get_u64(nla);
+    }
+    return 0;
+}
+
+/*
+ * 订阅事件多播组 seconds 秒。丢失的事件有两种表现：序号出现缺口，
+ * 以及 recv 返回 ENOBUFS（接收队列曾经溢出，每次溢出报告一次）。
+ * 请求（GET_STATS）走单独的 req_fd，避免回复与排队中的事件混在一起。
+ */
+static int listen_test(int req_fd, uint16_t family, uint32_t grp, int seconds, int rcvbuf) {
+    static char buf[1 << 16];
+    struct timeval tv = { .tv_usec = 100000 };
+    struct u2k_kstats st0, st1;
+    uint64_t last_seq = 0;
+    uint64_t events = 0, lost = 0, enobufs = 0, lat_sum = 0, lat_max = 0;
+    uint64_t start, tick, end;
+    int fd, have_last = 0, one = 1, ret;
+
+    fd = genl_open();
+    if (fd < 0) {
+        return -1;
+    }
+    // 接收缓冲区决定能吸收多大的突发，非 root 时实际值受 net.core.rmem_max 限制
+    set_rcvbuf(fd, rcvbuf);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    // 让内核在本套接字接收队列满时向广播者报告 ENOBUFS，kernel 一行的 dropped 才有意义
+    setsockopt(fd, SOL_NETLINK, NETLINK_BROADCAST_ERROR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &grp, sizeof(grp)) < 0) {
+        perror("NETLINK_ADD_MEMBERSHIP");
+        close(fd);
+        return -1;
+    }
+    ret = u2k_get_stats(req_fd, family, &st0);
+    if (ret < 0) {
+        fprintf(stderr, "GET_STATS failed: %s\n", strerror(-ret));
+        close(fd);
+        return -1;
+    }
+
+    printf("joined group %s (id %u) for %d s, rcvbuf %d KB\n", U2K_GENL_MCGRP_EVENTS, grp, seconds, rcvbuf >> 10);
+    printf("%4s %12s %10s %8s %10s %10s\n", "sec", "events/s", "lost", "enobufs", "avg_us", "max_us");
+    start = now_ns();
+    tick = start + 1000000000ULL;
+    end = start + seconds * 1000000000ULL;
+    while (1) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        uint64_t now = now_ns();
+        struct nlmsghdr *nlh;
+
+        if (n < 0 && errno == ENOBUFS) {
+            enobufs++;
+        } else if (n < 0 && errno != EAGAIN) {
+            perror("recv");
+            break;
+        }
+        for (nlh = (struct nlmsghdr *)buf; n > 0 && NLMSG_OK(nlh, n); nlh = NLMSG_NEXT(nlh, n)) {
+            struct nlattr *seq = genl_find(nlh, U2K_ATTR_EVENT_SEQ);
+            struct nlattr *ts = genl_find(nlh, U2K_ATTR_TIMESTAMP);
+            uint64_t s, lat;
+
+            if (nlh->nlmsg_type != family || !seq || !ts) {
+                continue;
+            }
+            s = nla_get_u64(seq);
+            if (have_last && s > last_seq + 1) {
+                lost += s - last_seq - 1;
+            }
+            last_seq = s;
+            have_last = 1;
+            lat = now - nla_get_u64(ts);  // 内核与用户态都是 CLOCK_MONOTONIC
+            lat_sum += lat;
+            if (lat > lat_max) {
+                lat_max = lat;
+            }
+            events++;
+        }
+
+        if (now >= tick) {
+            printf("%4llu %12llu %10llu %8llu %10.1f %10.1f\n", (unsigned long long)((tick - start) / 1000000000ULL),
+                   (unsigned long long)events, (unsigned long long)lost, (unsigned long long)enobufs,
+                   events ? lat_sum / 1e3 / events : 0.0, lat_max / 1e3);
+            events = lost = enobufs = lat_sum = lat_max = 0;
+            tick += 1000000000ULL;
+        }
+        if (now >= end) {
+            break;
+        }
+    }
+
+    // 退出多播组后内核不再向本 socket 投递，已排队的事件随 close 丢弃
+    setsockopt(fd, SOL_NETLINK, NETLINK_DROP_MEMBERSHIP, &grp, sizeof(grp));
+    close(fd);
+    ret = u2k_get_stats(req_fd, family, &st1);
+    if (ret < 0) {
+        fprintf(stderr, "GET_STATS failed: %s\n", strerror(-ret));
+        return -1;
+    }
+    printf("kernel: %llu events broadcast, %llu dropped by a full subscriber (all subscribers)\n",
+           (unsigned long long)(st1.events - st0.events), (unsigned long long)(st1.drops - st0.drops));
+    return 0;
+}
+
+// churn 子进程：随机地插入或删除表中的记录，直到被父进程杀死
+static void churn_loop(uint16_t family) {
+    struct genl_msg msg;
+    int fd = genl_open();
+
+    if (fd < 0) {
+        return;
+    }
+    srand(getpid());
+    for (;;) {
+        uint32_t key = rand() % (1 << 21);  // 一半落在初始表内，一半是新键
+        uint64_t value = rand();
+
+        genl_init(&msg.nlh, family, rand() & 1 ? U2K_CMD_TABLE_SET : U2K_CMD_TABLE_DEL, U2K_GENL_VERSION);
+        msg.nlh.nlmsg_flags |= NLM_F_ACK;  // 每条请求都有应答，接收队列不会积压
+        genl_put(&msg.nlh, U2K_ATTR_KEY, &key, sizeof(key));
+        if (msg.gnlh.cmd == U2K_CMD_TABLE_SET) {
+            genl_put(&msg.nlh, U2K_ATTR_VALUE, &value, sizeof(value));
+        }
+        if (genl_send(fd, &msg, msg.nlh.nlmsg_len) < 0) {
+            break;
+        }
+        // DEL 不存在的键返回 ENOENT，忽略；没有 CAP_NET_ADMIN 时返回 EPERM
+        if (genl_recv(fd, &msg) == -EPERM) {
+            fprintf(stderr, "churn: TABLE_SET/TABLE_DEL need CAP_NET_ADMIN\n");
+            break;
+        }
+    }
+    close(fd);
+}
+
+/*
+ * 转储整张表：一个 NLM_F_DUMP 请求，内核每次填满一个 skb，直到 NLMSG_DONE。
+ * 检查 KEY 严格递增（并发修改下也不应重复或乱序），报告吞吐与每次 recv 携带的记录数。
+ */
+static int dump_test(int fd, uint16_t family, int churn) {
+    static char buf[1 << 16];  // 内核按 recvmsg 的缓冲区大小增长转储 skb，最大约 32KB
+    struct genl_msg msg;
+    uint64_t entries = 0, recvs = 0, start;
+    uint32_t last_key = 0;
+    int done = 0, intr = 0, ret = 0;
+    pid_t child = -1;
+
+    if (churn) {
+        child = fork();
+        if (child == 0) {
+            churn_loop(family);
+            _exit(0);
+        }
+    }
+
+    start = now_ns();
+    genl_init(&msg.nlh, family, U2K_CMD_TABLE_GET, U2K_GENL_VERSION);
+    msg.nlh.nlmsg_flags |= NLM_F_DUMP;
+    if (genl_send(fd, &msg, msg.nlh.nlmsg_len) < 0) {
+        ret = -1;
+        done = 1;
+    }
+    while (!done) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        struct nlmsghdr *nlh;
+
+        if (n < 0) {
+            perror("recv");
+            ret = -1;
+            break;
+        }
+        recvs++;
+        for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, n); nlh = NLMSG_NEXT(nlh, n)) {
+            struct nlattr *key;
+
+            if (nlh->nlmsg_flags & NLM_F_DUMP_INTR) {
+                intr = 1;
+            }
+            if (nlh->nlmsg_type == NLMSG_DONE || nlh->nlmsg_type == NLMSG_ERROR) {
+                int err = *(int *)NLMSG_DATA(nlh);  // NLMSG_DONE 与 nlmsgerr 的第一个字段都是错误码
+
+                if (err < 0) {
+                    fprintf(stderr, "dump failed: %s\n", strerror(-err));
+                    ret = -1;
+                }
+                done = 1;
+                break;
+            }
+            key = genl_find(nlh, U2K_ATTR_KEY);
+            if (!key || (entries && *(uint32_t *)NLA_DATA(key) <= last_key)) {
+                fprintf(stderr, "dump: bad or out-of-order key after %u\n", last_key);
+                ret = -1;
+                done = 1;
+                break;
+            }
+            last_key = *(uint32_t *)NLA_DATA(key);
+            entries++;
+        }
+    }
+
+    if (child > 0) {
+        kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+    }
+    if (!ret) {
+        double secs = (now_ns() - start) / 1e9;
+
+        printf("dumped %llu entries in %.3f s: %.0f entries/s, %llu recvs, %.1f entries/recv%s\n",
+               (unsigned long long)entries, secs, entries / secs, (unsigned long long)recvs,
+               (double)entries / recvs, intr ? ", interrupted by concurrent changes (NLM_F_DUMP_INTR)" : "");
+    }
+    return ret;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * 流水线：始终保持 window 条未完成的 INCR（VALUE = 请求编号），每条请求单独一个 datagram。
+ * 请求与接收缓冲区都预先分配并重复使用：请求槽按 (seq - base) % PIPE_WINDOW_MAX 索引，
+ * 槽中的消息头只在第一次使用时构造，之后只改序号和值。回复按序号找回发送时间，计算延迟。
+ */
+static int pipeline_bench(int fd, int req_fd, uint16_t family, int window, long total, uint64_t *lat) {
+    static char reqs[PIPE_WINDOW_MAX][PIPE_REQ_SIZE], rbufs[PIPE_MMSG][PIPE_RBUF_SIZE];
+    static struct iovec siov[PIPE_WINDOW_MAX], riov[PIPE_MMSG];
+    static struct mmsghdr smsgs[PIPE_MMSG], rmsgs[PIPE_MMSG];
+    static uint64_t sent_at[PIPE_WINDOW_MAX];
+    struct sockaddr_nl dest_addr = { .nl_family = AF_NETLINK };
+    uint32_t base = seq_next;
+    long sent = 0, done = 0, syscalls = 0;
+    struct u2k_kstats st0, st1;
+    uint64_t start;
+    int i;
+
+    // 池的命中率通过另一个 socket 查询，避免回复混入流水线的接收队列
+    if (u2k_get_stats(req_fd, family, &st0) < 0) {
+        memset(&st0, 0, sizeof(st0));
+    }
+
+    for (i = 0; i < PIPE_WINDOW_MAX; i++) {
+        struct nlmsghdr *nlh = (struct nlmsghdr *)reqs[i];
+        uint64_t value = 0;
+
+        genl_init(nlh, family, U2K_CMD_INCR, U2K_GENL_VERSION);
+        genl_put(nlh, U2K_ATTR_VALUE, &value, sizeof(value));
+        siov[i].iov_base = nlh;
+        siov[i].iov_len = nlh->nlmsg_len;
+    }
+    for (i = 0; i < PIPE_MMSG; i++) {
+        riov[i].iov_base = rbufs[i];
+        riov[i].iov_len = PIPE_RBUF_SIZE;
+        rmsgs[i].msg_hdr.msg_iov = &riov[i];
+        rmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    seq_next = base;  // 上面只是构造消息头，序号从 base 重新分配
+
+    start = now_ns();
+    while (done < total) {
+        int k = window - (int)(sent - done), n;
+
+        // 补满窗口
+        if (k > total - sent) {
+            k = total - sent;
+        }
+        if (k > PIPE_MMSG) {
+            k = PIPE_MMSG;
+        }
+        if (k > 0) {
+            uint64_t now = now_ns();
+
+            for (i = 0; i < k; i++) {
+                uint32_t slot = (sent + i) & (PIPE_WINDOW_MAX - 1);
+                struct nlmsghdr *nlh = (struct nlmsghdr *)reqs[slot];
+                uint64_t value = sent + i;
+
+                nlh->nlmsg_seq = base + sent + i;
+                memcpy(NLA_DATA(GENL_ATTRS(nlh)), &value, sizeof(value));
+                sent_at[slot] = now;
+                smsgs[i].msg_hdr.msg_name = &dest_addr;
+                smsgs[i].msg_hdr.msg_namelen = sizeof(dest_addr);
+                smsgs[i].msg_hdr.msg_iov = &siov[slot];
+                smsgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            n = sendmmsg(fd, smsgs, k, 0);
+            if (n < 0) {
+                perror("sendmmsg");
+                return -1;
+            }
+            sent += n;
+            syscalls++;
+        }
+
+        // 至少等到一条回复，再把已经到达的一并取走
+        n = recvmmsg(fd, rmsgs, PIPE_MMSG, MSG_WAITFORONE, NULL);
+        if (n < 0) {
+            perror("recvmmsg");  // ENOBUFS：窗口内的回复超出了接收缓冲区
+            return -1;
+        }
+        syscalls++;
+        for (i = 0; i < n; i++) {
+            uint64_t now = now_ns();
+            int len = rmsgs[i].msg_len;
+            struct nlmsghdr *nlh;
+
+            for (nlh = (struct nlmsghdr *)rbufs[i]; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+                uint32_t idx = nlh->nlmsg_seq - base;
+                struct nlattr *nla;
+
+                if (nlh->nlmsg_type == NLMSG_ERROR) {
+                    fprintf(stderr, "seq %u: %s\n", nlh->nlmsg_seq,
+                            strerror(-((struct nlmsgerr *)NLMSG_DATA(nlh))->error));
+                    return -1;
+                }
+                nla = genl_find(nlh, U2K_ATTR_VALUE);
+                if (idx >= (uint32_t)sent || !nla || nla_get_u64(nla) != (uint64_t)idx + 1) {
+                    fprintf(stderr, "unexpected reply seq %u\n", nlh->nlmsg_seq);
+                    return -1;
+                }
+                lat[done++] = now - sent_at[idx & (PIPE_WINDOW_MAX - 1)];
+            }
+        }
+    }
+    seq_next = base + sent;
+
+    {
+        double secs = (now_ns() - start) / 1e9;
+
+        qsort(lat, total, sizeof(*lat), cmp_u64);
+        printf("window %-4d %12.0f req/s %8.1f msg/syscall  p50 %7.1f  p99 %7.1f  p999 %7.1f us", window,
+               total / secs, 2.0 * total / syscalls, lat[total / 2] / 1e3, lat[total * 99 / 100] / 1e3,
+               lat[total * 999 / 1000] / 1e3);
+    }
+    if (u2k_get_stats(req_fd, family, &st1) == 0) {
+        printf("  pool %llu hit / %llu miss", (unsigned long long)(st1.pool_hits - st0.pool_hits),
+               (unsigned long long)(st1.pool_misses - st0.pool_misses));
+    }
+    printf("\n");
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int batch_mode = argc > 1 && strcmp(argv[1], "batch") == 0;
+    int listen_mode = argc > 1 && strcmp(argv[1], "listen") == 0;
+    int dump_mode = argc > 1 && strcmp(argv[1], "dump") == 0;
+    int pipeline_mode = argc > 1 && strcmp(argv[1], "pipeline") == 0;
+    uint64_t value = argc > 1 && !batch_mode && !listen_mode && !dump_mode && !pipeline_mode ?
+                     strtoull(argv[1], NULL, 0) : 123;
+    int rcvbuf = RCVBUF_SIZE;
+    char echo_buf[U2K_DATA_MAX];
+    uint64_t result;
+    uint32_t grp = 0;
+    int sock_fd, family, ret;
+
+    // 创建 generic netlink socket
+    sock_fd = genl_open();
+    if (sock_fd < 0) {
+        return -1;
+    }
+
+    family = genl_resolve(sock_fd, U2K_GENL_NAME, listen_mode ? U2K_GENL_MCGRP_EVENTS : NULL, &grp);
+    if (family < 0) {
+        fprintf(stderr, "resolve family %s: %s (is netlink_kernel.ko loaded?)\n", U2K_GENL_NAME, strerror(-family));
         close(sock_fd);
         return -1;
     }
+    printf("Family %s id %d\n", U2K_GENL_NAME, family);
+
+    if (listen_mode) {
+        int seconds = argc > 2 ? atoi(argv[2]) : LISTEN_SECS;
+
+        rcvbuf = argc > 3 ? atoi(argv[3]) << 10 : 208 << 10;  // 默认与 net.core.rmem_default 相同
+        ret = listen_test(sock_fd, family, grp, seconds, rcvbuf);
+        close(sock_fd);
+        return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (pipeline_mode) {
+        long total = argc > 2 ? atol(argv[2]) : PIPE_TOTAL;
+        uint64_t *lat = total > 0 ? malloc(total * sizeof(*lat)) : NULL;
+        int window, req_fd, errors = 0;
+
+        req_fd = genl_open();
+        if (!lat || req_fd < 0) {
+            fprintf(stderr, "invalid total or socket\n");
+            close(sock_fd);
+            return EXIT_FAILURE;
+        }
+        set_rcvbuf(sock_fd, rcvbuf);
+        for (window = 1; window <= PIPE_WINDOW_MAX && !errors; window *= 4) {
+            if (pipeline_bench(sock_fd, req_fd, family, window, total, lat) < 0) {
+                errors++;
+            }
+        }
+        free(lat);
+        close(req_fd);
+        close(sock_fd);
+        return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
 
-    // 接收来自内核的消息
-    memset(nlh, 0, NLMSG_SPACE(MAX_PAYLOAD));
-    if (recvmsg(sock_fd, &msg, 0) < 0) {
-        perror("recvmsg failed");
-        free(nlh);
+    if (dump_mode) {
+        ret = dump_test(sock_fd, family, argc > 2 && strcmp(argv[2], "churn") == 0);
+        close(sock_fd);
+        return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (batch_mode) {
+        long total = argc > 2 ? atol(argv[2]) : BATCH_TOTAL;
+        int batch, errors = 0;
+
+        // 一批回复在读取之前全部排在接收队列中，需要足够大的接收缓冲区
+        set_rcvbuf(sock_fd, rcvbuf);
+        if (ack_test(sock_fd, family) < 0) {
+            errors++;
+        }
+        for (batch = 1; batch <= BATCH_MAX && !errors; batch *= 4) {
+            if (batch_bench(sock_fd, family, batch, total) < 0) {
+                errors++;
+            }
+        }
+        close(sock_fd);
+        return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    printf("Sending INCR to kernel: %llu\n", (unsigned long long)value);
+    ret = u2k_incr(sock_fd, family, value, 1, &result);
+    if (ret < 0) {
+        fprintf(stderr, "INCR failed: %s\n", strerror(-ret));
         close(sock_fd);
         return -1;
     }
+    printf("Received from kernel: %llu\n", (unsigned long long)result);
 
-    printf("Received from kernel: %s\n", (char *)NLMSG_DATA(nlh));
+    ret = u2k_echo(sock_fd, family, "hello genetlink", sizeof("hello genetlink"), echo_buf);
+    if (ret < 0) {
+        fprintf(stderr, "ECHO failed: %s\n", strerror(-ret));
+        close(sock_fd);
+        return -1;
+    }
+    printf("Echo from kernel: %.*s\n", ret, echo_buf);
 
-    free(nlh);
     close(sock_fd);
-
     return 0;
 }
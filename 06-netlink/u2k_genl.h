@@ -0,0 +1,63 @@
+#ifndef U2K_GENL_H
+#define U2K_GENL_H
+
+/*
+ * netlink_kernel.ko 注册的 generic netlink family，内核模块与用户态程序共用本头文件。
+ *
+ * family ID 由内核动态分配，用户态通过 nlctrl（CTRL_CMD_GETFAMILY）按名字解析，
+ * 不再占用固定的 netlink 协议号。消息体是 genlmsghdr + NLA 属性，数值按二进制传递，
+ * 内核按 policy 校验属性的类型与长度，不需要 kstrtoint/snprintf。
+ *
+ * genlmsghdr.version 为发送方使用的协议版本，内核拒绝高于 U2K_GENL_VERSION 的请求；
+ * 新版本只能新增命令和属性，已有编号与语义保持不变。
+ *
+ * 多播组 U2K_GENL_MCGRP_EVENTS：加载参数 event_rate 非 0 时，内核线程按该速率向组内广播
+ * U2K_CMD_EVENT。组 ID 同样从 CTRL_CMD_GETFAMILY 的回复（CTRL_ATTR_MCAST_GROUPS）中解析，
+ * 用 setsockopt(NETLINK_ADD_MEMBERSHIP / NETLINK_DROP_MEMBERSHIP) 随时加入或退出。
+ * 订阅者需要在加入前设置 NETLINK_BROADCAST_ERROR，内核才能得知它的接收队列满而丢失了事件，
+ * 否则 EVENT_DROPS 只统计唯一的订阅者溢出（无人收到）的情况。
+ *
+ * 表 KEY -> VALUE（加载参数 table_size 条，初始 VALUE = KEY）：
+ * U2K_CMD_TABLE_GET 带 NLM_F_DUMP 时按 KEY 升序分多个 skb 返回整张表，每条记录一个消息（NLM_F_MULTI），
+ * 以 NLMSG_DONE 结束。转储期间表被修改时，之后的消息带 NLM_F_DUMP_INTR，
+ * 此时结果不是某一时刻的快照，但不会重复或漏掉转储期间未被修改的记录。
+ */
+
+#define U2K_GENL_NAME "u2k_demo"
+#define U2K_GENL_VERSION 1
+#define U2K_GENL_MCGRP_EVENTS "events"
+
+enum u2k_genl_cmd {
+    U2K_CMD_UNSPEC,
+    U2K_CMD_INCR,      // 请求 VALUE（必需）、DELTA（可选，默认 1），回复 VALUE = VALUE + DELTA
+    U2K_CMD_ECHO,      // 请求 DATA，回复原样的 DATA
+    U2K_CMD_EVENT,     // 只由内核广播：EVENT_SEQ、TIMESTAMP、DATA（event_size 字节）
+    U2K_CMD_GET_STATS, // 无请求属性，回复 EVENTS、EVENT_DROPS、POOL_HITS、POOL_MISSES
+    U2K_CMD_TABLE_GET, // 请求 KEY，回复 KEY、VALUE；带 NLM_F_DUMP 时转储整张表
+    U2K_CMD_TABLE_SET, // 请求 KEY、VALUE（不超过 INT64_MAX），插入或覆盖；需要 CAP_NET_ADMIN
+    U2K_CMD_TABLE_DEL, // 请求 KEY；需要 CAP_NET_ADMIN
+    __U2K_CMD_MAX,
+};
+#define U2K_CMD_MAX (__U2K_CMD_MAX - 1)
+
+enum u2k_genl_attr {
+    U2K_ATTR_UNSPEC,
+    U2K_ATTR_PAD,    // u64 属性的对齐填充（nla_put_u64_64bit）
+    U2K_ATTR_VALUE,  // u64
+    U2K_ATTR_DELTA,  // u32
+    U2K_ATTR_DATA,   // binary，最长 U2K_DATA_MAX 字节
+    // 以下四个属性只出现在内核发出的消息中，出现在请求中会被拒绝
+    U2K_ATTR_EVENT_SEQ,    // u64，事件序号，订阅者据此发现丢失的事件
+    U2K_ATTR_TIMESTAMP,    // u64，事件生成时的 CLOCK_MONOTONIC 纳秒
+    U2K_ATTR_EVENTS,       // u64，已广播的事件数
+    U2K_ATTR_EVENT_DROPS,  // u64，至少一个订阅者因接收缓冲区满而丢失的事件数（见上文 NETLINK_BROADCAST_ERROR）
+    U2K_ATTR_KEY,          // u32，表的键
+    U2K_ATTR_POOL_HITS,    // u64，回复直接取自预分配 skb 池的次数（只由内核发出）
+    U2K_ATTR_POOL_MISSES,  // u64，池为空而在热路径上分配 skb 的次数（只由内核发出）
+    __U2K_ATTR_MAX,
+};
+#define U2K_ATTR_MAX (__U2K_ATTR_MAX - 1)
+
+#define U2K_DATA_MAX 1024
+
+#endif // U2K_GENL_H
@@ -0,0 +1,96 @@
+#ifndef SQPOLL_DEMO_H
+#define SQPOLL_DEMO_H
+
+/*
+ * sqpoll_demo 内核模块与用户态程序共享的定义。
+ *
+ * 每次 open("/dev/sqpoll_demo") 得到一对提交队列（SQ）/完成队列（CQ）和一个内核轮询线程，
+ * 二者都位于 mmap 偏移 0 处的同一块共享内存中：
+ *   [控制页 struct sqpoll_ctrl][SQE 数组][CQE 数组]
+ * 用户态先只映射控制页，从中读出整个区域的大小与各数组的偏移，再映射整个区域。
+ *
+ * 提交：写 sqes[sq_tail & (sq_entries - 1)] -> store_release(sq_tail)。
+ * 内核线程轮询 sq_tail，按顺序执行命令，把结果写入 CQ 后 store_release(cq_tail)；
+ * 用户态 load_acquire(cq_tail) -> 读 CQE -> store_release(cq_head)。
+ * 四个下标都是单调递增的 32 位计数，各自独占一个 cache line。
+ * 稳态下提交与收割都不需要任何系统调用。
+ *
+ * 轮询线程连续 sq_idle_us（加载参数）没有拿到新的 SQE 后，在 flags 中置 SQPOLL_NEED_WAKEUP
+ * 并在等待队列上睡眠。用户态发布 sq_tail 之后需要一次全屏障再检查 flags，
+ * 看到 SQPOLL_NEED_WAKEUP 时调用 ioctl(SQPOLL_IOC_WAKEUP) 唤醒它（与 io_uring 的 SQPOLL 相同）。
+ *
+ * 内核只在 CQ 有空位时才取走 SQE，因此 CQ 永远不会溢出；未完成的命令不超过 sq_entries 条时，
+ * CQ（2 * sq_entries 项）也不会成为瓶颈。也可以用 poll()/epoll 等待 CQ 非空（EPOLLIN）。
+ * CQ 满而 SQ 中还有命令时，轮询线程同样在 sq_idle_us 之后置 SQPOLL_NEED_WAKEUP 睡眠，
+ * 此时用户态收割一批 CQE 后也要“store_release(cq_head) -> 全屏障 -> 检查 flags”，必要时唤醒它。
+ */
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define SQPOLL_NR_SLOTS 64    // 命令操作的 64 位槽位个数，所有打开的文件共享
+
+#define SQPOLL_NEED_WAKEUP (1U << 0)  // sqpoll_ctrl.flags：轮询线程已睡眠，提交后需要唤醒
+
+// 命令
+enum {
+    SQPOLL_OP_NOP,        // 什么也不做，result = 0
+    SQPOLL_OP_GET,        // result = slot
+    SQPOLL_OP_SET,        // slot = arg
+    SQPOLL_OP_FETCH_ADD,  // result = slot, slot += arg
+    SQPOLL_OP_NR,
+};
+
+// 提交队列项，32 字节
+struct sqpoll_sqe {
+    __u8  opcode;     // SQPOLL_OP_*
+    __u8  pad[3];     // 必须为 0
+    __u32 slot;       // 槽位下标
+    __u64 arg;        // 操作数
+    __u64 user_data;  // 原样带回 CQE，用于匹配请求与完成
+    __u64 reserved;   // 必须为 0
+};
+
+// 完成队列项，24 字节
+struct sqpoll_cqe {
+    __u64 user_data;  // 对应 SQE 的 user_data
+    __u64 result;     // 命令的结果，如 GET 读到的值
+    __s32 status;     // 0 表示成功，负数为错误码
+    __u32 reserved;
+};
+
+/*
+ * 控制页，位于映射区域的第一页。
+ * sq_tail、cq_head 由用户写；sq_head、cq_tail、flags 与统计字段由内核写，用户写入会被忽略。
+ */
+struct sqpoll_ctrl {
+    __u32 sq_head;       // 内核已取走的 SQE（内核写）
+    __u8  pad0[60];
+    __u32 sq_tail;       // 用户已提交的 SQE（用户写）
+    __u8  pad1[60];
+    __u32 cq_head;       // 用户已收割的 CQE（用户写）
+    __u8  pad2[60];
+    __u32 cq_tail;       // 内核已发布的 CQE（内核写）
+    __u32 flags;         // SQPOLL_NEED_WAKEUP（内核写）
+    __u8  pad3[56];
+    __u32 sq_entries;    // SQ 项数，2 的幂
+    __u32 cq_entries;    // CQ 项数，2 * sq_entries
+    __u64 sq_offset;     // SQE 数组相对映射起始的字节偏移
+    __u64 cq_offset;     // CQE 数组相对映射起始的字节偏移
+    __u64 ring_size;     // 整个区域的大小（字节），按页对齐
+    __u64 sleeps;        // 轮询线程空闲超时后睡眠的次数
+    __u64 cq_full;       // 因 CQ 满而暂停取 SQE 的次数（一次连续的停顿计一次）
+};
+
+/*
+ * 对照组：SQPOLL_IOC_EXEC 在调用者的上下文中同步执行一条命令，与轮询线程共用实现，
+ * 用于在同一驱动上比较“每条命令一次陷入”与共享队列的延迟和吞吐。
+ */
+struct sqpoll_exec {
+    struct sqpoll_sqe sqe;  // 输入
+    struct sqpoll_cqe cqe;  // 输出
+};
+
+#define SQPOLL_IOC_WAKEUP _IO('q', 1)                       // 唤醒睡眠中的轮询线程
+#define SQPOLL_IOC_EXEC   _IOWR('q', 2, struct sqpoll_exec) // 同步执行一条命令
+
+#endif // SQPOLL_DEMO_H
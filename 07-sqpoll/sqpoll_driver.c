@@ -0,0 +1,459 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/log2.h>
+#include <linux/atomic.h>
+#include <linux/nospec.h>
+#include <linux/ktime.h>
+#include <linux/version.h>
+
+#include "sqpoll_demo.h"
+#include "u2k_stats.h"
+#include "u2k_lat.h"   // 延迟直方图（u2k_common.ko）
+#include "u2k_trace.h" // 跟踪点（u2k_common.ko）
+
+#define DEVICE_NAME "sqpoll_demo"   // 设备名称
+#define CLASS_NAME "sqpoll_class"   // 设备类名称
+#define SQPOLL_MAX_ENTRIES 4096     // SQ 项数上限
+
+// 每个打开的文件的 SQ 项数（向上取整到 2 的幂），CQ 为其两倍
+static unsigned int sq_entries = 256;
+module_param(sq_entries, uint, 0644);
+MODULE_PARM_DESC(sq_entries, "Number of submission queue entries per open file (power of 2, max 4096)");
+
+// 轮询线程连续空闲多久后睡眠，0 表示队列一空就睡眠
+static unsigned int sq_idle_us = 2000;
+module_param(sq_idle_us, uint, 0644);
+MODULE_PARM_DESC(sq_idle_us, "Microseconds the poller spins on an empty queue before sleeping");
+
+// 轮询线程绑定的 CPU，-1 表示不绑定
+static int sq_cpu = -1;
+module_param(sq_cpu, int, 0644);
+MODULE_PARM_DESC(sq_cpu, "CPU the poller threads are bound to (-1 = any)");
+
+enum {
+    SQPOLL_STAT_SQE,      // 轮询线程执行的命令数
+    SQPOLL_STAT_EXEC,     // SQPOLL_IOC_EXEC 执行的命令数
+    SQPOLL_STAT_WAKEUP,   // SQPOLL_IOC_WAKEUP 调用次数
+    SQPOLL_STAT_SLEEP,    // 轮询线程睡眠次数
+    SQPOLL_STAT_CQ_FULL,  // 因 CQ 满暂停取 SQE 的次数
+    SQPOLL_STAT_NR,
+};
+static DEFINE_PER_CPU(struct u2k_stats, sqpoll_stats);
+
+// 延迟直方图 /proc/u2k/sqpoll：一次 SQPOLL_IOC_EXEC，以及轮询线程一轮收割（可能包含多条命令）
+enum {
+    SQPOLL_LAT_EXEC,
+    SQPOLL_LAT_REAP,
+    SQPOLL_LAT_NR,
+};
+static const char *const sqpoll_lat_names[SQPOLL_LAT_NR] = { "ioctl_exec", "reap" };
+static struct u2k_lat *sqpoll_lat;
+
+static dev_t dev_num;               // 设备号
+static struct cdev sqpoll_cdev;     // 字符设备结构体
+static struct class *sqpoll_class;  // 设备类
+static struct device *sqpoll_device; // 设备结构体
+
+// 命令操作的槽位，每个槽位独占一个 cache line
+static struct {
+    atomic64_t value;
+} ____cacheline_aligned_in_smp slots[SQPOLL_NR_SLOTS];
+
+/*
+ * 每个打开的文件一个上下文。SQ 的读位置与 CQ 的写位置以内核私有的副本为准，
+ * 控制页中的 sq_head/cq_tail 只是发布给用户态的值，用户改写它们不影响内核。
+ */
+struct sqpoll_ctx {
+    void *ring;                   // 控制页 + SQE + CQE，vmalloc_user 分配
+    struct sqpoll_ctrl *ctrl;
+    struct sqpoll_sqe *sqes;
+    struct sqpoll_cqe *cqes;
+    u32 sq_mask, cq_mask;
+    u32 sq_head;                  // 下一个要取的 SQE
+    u32 cq_tail;                  // 下一个要写的 CQE
+    bool cq_stalled;              // 上一轮因 CQ 满而停止，同一次停顿只计数一次
+    struct task_struct *task;     // 轮询线程
+    wait_queue_head_t sq_wait;    // 轮询线程在这里睡眠
+    wait_queue_head_t cq_wait;    // poll() 在这里等待 CQ 非空
+};
+
+// 执行一条命令，轮询线程与 SQPOLL_IOC_EXEC 共用
+static int sqpoll_exec(const struct sqpoll_sqe *sqe, u64 *result) {
+    atomic64_t *v;
+
+    *result = 0;
+    // 保留字段必须为 0，以后才能赋予它们含义
+    if (sqe->reserved || memchr_inv(sqe->pad, 0, sizeof(sqe->pad))) {
+        return -EINVAL;
+    }
+    if (sqe->opcode == SQPOLL_OP_NOP) {
+        return 0;
+    }
+    if (sqe->slot >= SQPOLL_NR_SLOTS) {
+        return -EINVAL;
+    }
+    v = &slots[array_index_nospec(sqe->slot, SQPOLL_NR_SLOTS)].value;
+
+    switch (sqe->opcode) {
+        case SQPOLL_OP_GET:
+            *result = atomic64_read(v);
+            return 0;
+        case SQPOLL_OP_SET:
+            atomic64_set(v, sqe->arg);
+            return 0;
+        case SQPOLL_OP_FETCH_ADD:
+            *result = atomic64_fetch_add(sqe->arg, v);
+            return 0;
+        default:
+            return -EINVAL;
+    }
+}
+
+// SQ 中是否有尚未取走的 SQE
+static bool sqpoll_sq_pending(struct sqpoll_ctx *ctx) {
+    return READ_ONCE(ctx->ctrl->sq_tail) != ctx->sq_head;
+}
+
+// CQ 是否还有空位；cq_head 由用户写，只用于判断，不用作下标
+static bool sqpoll_cq_room(struct sqpoll_ctx *ctx) {
+    return ctx->cq_tail - smp_load_acquire(&ctx->ctrl->cq_head) <= ctx->cq_mask;
+}
+
+// 轮询线程能否取到 SQE：SQ 非空且 CQ 有空位
+static bool sqpoll_can_reap(struct sqpoll_ctx *ctx) {
+    return sqpoll_sq_pending(ctx) && sqpoll_cq_room(ctx);
+}
+
+/*
+ * 收割一轮：执行 SQ 中已发布的全部 SQE（受 CQ 空位限制），返回执行的条数。
+ * SQE 先整体复制到栈上再解析，用户态同时改写共享内存也不会让内核读到前后不一致的字段。
+ */
+static unsigned int sqpoll_reap(struct sqpoll_ctx *ctx) {
+    struct sqpoll_ctrl *ctrl = ctx->ctrl;
+    u32 head = ctx->sq_head, cq_tail = ctx->cq_tail;
+    // acquire：看到 sq_tail 之后，用户对这些 SQE 的写入一定可见
+    u32 tail = smp_load_acquire(&ctrl->sq_tail);
+    u32 cq_head = smp_load_acquire(&ctrl->cq_head);
+    u32 cq_entries = ctx->cq_mask + 1;
+    unsigned int nr = 0;
+    bool stalled = false;
+    u64 start;
+
+    if (tail == head) {
+        return 0;
+    }
+    // sq_tail 由用户写，越界时最多处理一整圈
+    if (tail - head > ctx->sq_mask + 1) {
+        tail = head + ctx->sq_mask + 1;
+    }
+
+    start = u2k_lat_start();
+    while (head != tail) {
+        struct sqpoll_sqe sqe;
+        struct sqpoll_cqe *cqe;
+        u64 result;
+        int status;
+
+        if (cq_tail - cq_head >= cq_entries) {
+            cq_head = smp_load_acquire(&ctrl->cq_head);
+            if (cq_tail - cq_head >= cq_entries) {
+                stalled = true;
+                break;  // CQ 满，剩下的 SQE 留到用户收割之后
+            }
+        }
+
+        memcpy(&sqe, &ctx->sqes[head & ctx->sq_mask], sizeof(sqe));
+        status = sqpoll_exec(&sqe, &result);
+
+        cqe = &ctx->cqes[cq_tail & ctx->cq_mask];
+        cqe->user_data = sqe.user_data;
+        cqe->result = result;
+        cqe->status = status;
+        cqe->reserved = 0;
+        head++;
+        cq_tail++;
+        nr++;
+    }
+
+    if (stalled && !ctx->cq_stalled) {
+        u2k_stats_inc(sqpoll_stats, SQPOLL_STAT_CQ_FULL);
+        WRITE_ONCE(ctrl->cq_full, ctrl->cq_full + 1);
+    }
+    ctx->cq_stalled = stalled;
+
+    if (nr) {
+        ctx->sq_head = head;
+        ctx->cq_tail = cq_tail;
+        smp_store_release(&ctrl->sq_head, head);
+        // release：CQE 的内容先于 cq_tail 对用户可见
+        smp_store_release(&ctrl->cq_tail, cq_tail);
+        u2k_stats_add(sqpoll_stats, SQPOLL_STAT_SQE, nr);
+        u2k_lat_end(sqpoll_lat, SQPOLL_LAT_REAP, start);
+        // wq_has_sleeper 带全屏障，与 poll() 中先入队再检查 cq_tail 配对
+        if (wq_has_sleeper(&ctx->cq_wait)) {
+            wake_up_interruptible(&ctx->cq_wait);
+        }
+    }
+    return nr;
+}
+
+/*
+ * 轮询线程：能取到 SQE 时持续收割；连续 sq_idle_us 取不到（SQ 为空，或 SQ 非空但 CQ 满）后
+ * 置 SQPOLL_NEED_WAKEUP 并睡眠，直到 SQ 非空且 CQ 有空位。
+ * 置位之后必须再检查一次：用户态是“写 sq_tail 或 cq_head -> 全屏障 -> 读 flags”，
+ * 这里是“写 flags -> 全屏障 -> 读 sq_tail 与 cq_head”，两边至少有一方能看到对方的写入，唤醒不会丢失。
+ */
+static int sqpoll_thread_fn(void *data) {
+    struct sqpoll_ctx *ctx = data;
+    u64 last = ktime_get_ns();
+
+    while (!kthread_should_stop()) {
+        if (sqpoll_reap(ctx)) {
+            last = ktime_get_ns();
+            cond_resched();
+            continue;
+        }
+        if (ktime_get_ns() - last < (u64)READ_ONCE(sq_idle_us) * NSEC_PER_USEC) {
+            cpu_relax();
+            cond_resched();
+            continue;
+        }
+
+        WRITE_ONCE(ctx->ctrl->flags, SQPOLL_NEED_WAKEUP);
+        smp_mb();
+        if (!sqpoll_can_reap(ctx)) {
+            u2k_stats_inc(sqpoll_stats, SQPOLL_STAT_SLEEP);
+            WRITE_ONCE(ctx->ctrl->sleeps, ctx->ctrl->sleeps + 1);
+            // 不计入负载，kthread_stop 会唤醒线程并让条件成立
+            wait_event_idle(ctx->sq_wait, kthread_should_stop() || sqpoll_can_reap(ctx));
+        }
+        WRITE_ONCE(ctx->ctrl->flags, 0);
+        last = ktime_get_ns();
+    }
+    return 0;
+}
+
+// 分配共享区域并启动轮询线程
+static int sqpoll_open(struct inode *inode, struct file *file) {
+    unsigned int entries = clamp_val(READ_ONCE(sq_entries), 1, SQPOLL_MAX_ENTRIES);
+    int cpu = READ_ONCE(sq_cpu);
+    struct sqpoll_ctx *ctx;
+    unsigned long size;
+
+    entries = roundup_pow_of_two(entries);
+    ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+    if (!ctx) {
+        return -ENOMEM;
+    }
+
+    size = PAGE_SIZE + entries * sizeof(struct sqpoll_sqe) + 2 * entries * sizeof(struct sqpoll_cqe);
+    size = PAGE_ALIGN(size);
+    ctx->ring = vmalloc_user(size); // 已清零，且可以安全映射到用户空间
+    if (!ctx->ring) {
+        kfree(ctx);
+        return -ENOMEM;
+    }
+    ctx->ctrl = ctx->ring;
+    ctx->sqes = ctx->ring + PAGE_SIZE;
+    ctx->cqes = (struct sqpoll_cqe *)(ctx->sqes + entries);
+    ctx->sq_mask = entries - 1;
+    ctx->cq_mask = 2 * entries - 1;
+    ctx->ctrl->sq_entries = entries;
+    ctx->ctrl->cq_entries = 2 * entries;
+    ctx->ctrl->sq_offset = (void *)ctx->sqes - ctx->ring;
+    ctx->ctrl->cq_offset = (void *)ctx->cqes - ctx->ring;
+    ctx->ctrl->ring_size = size;
+    init_waitqueue_head(&ctx->sq_wait);
+    init_waitqueue_head(&ctx->cq_wait);
+
+    ctx->task = kthread_create(sqpoll_thread_fn, ctx, "sqpoll/%d", task_pid_nr(current));
+    if (IS_ERR(ctx->task)) {
+        int ret = PTR_ERR(ctx->task);
+
+        vfree(ctx->ring);
+        kfree(ctx);
+        return ret;
+    }
+    if (cpu >= 0 && cpu < nr_cpu_ids && cpu_online(cpu)) {
+        kthread_bind(ctx->task, cpu);
+    }
+    wake_up_process(ctx->task);
+
+    file->private_data = ctx;
+    return 0;
+}
+
+// 最后一个引用（包括映射）释放后才会调用，此时用户态已经不能再访问共享区域
+static int sqpoll_release(struct inode *inode, struct file *file) {
+    struct sqpoll_ctx *ctx = file->private_data;
+
+    kthread_stop(ctx->task);
+    vfree(ctx->ring);
+    kfree(ctx);
+    return 0;
+}
+
+static int sqpoll_mmap(struct file *file, struct vm_area_struct *vma) {
+    struct sqpoll_ctx *ctx = file->private_data;
+    int ret;
+
+    trace_u2k_mmap_enter(vma->vm_pgoff, vma->vm_end - vma->vm_start);
+    // 只允许从偏移 0 开始映射，大小不超过整个区域；超出时 remap_vmalloc_range 返回 -EINVAL
+    if (vma->vm_pgoff) {
+        ret = -EINVAL;
+    } else {
+        ret = remap_vmalloc_range(vma, ctx->ring, 0);
+    }
+    trace_u2k_mmap_exit(vma->vm_pgoff, ret);
+    return ret;
+}
+
+// CQ 非空时可读
+static __poll_t sqpoll_poll(struct file *file, poll_table *wait) {
+    struct sqpoll_ctx *ctx = file->private_data;
+
+    poll_wait(file, &ctx->cq_wait, wait);
+    if (READ_ONCE(ctx->ctrl->cq_head) != READ_ONCE(ctx->cq_tail)) {
+        return EPOLLIN | EPOLLRDNORM;
+    }
+    return 0;
+}
+
+static long sqpoll_ioctl_exec(unsigned long arg) {
+    struct sqpoll_exec __user *uexec = (struct sqpoll_exec __user *)arg;
+    struct sqpoll_sqe sqe;
+    struct sqpoll_cqe cqe = {};
+
+    if (copy_from_user(&sqe, &uexec->sqe, sizeof(sqe))) {
+        return -EFAULT;
+    }
+    cqe.user_data = sqe.user_data;
+    cqe.status = sqpoll_exec(&sqe, &cqe.result);
+    if (copy_to_user(&uexec->cqe, &cqe, sizeof(cqe))) {
+        return -EFAULT;
+    }
+    u2k_stats_inc(sqpoll_stats, SQPOLL_STAT_EXEC);
+    return 0;
+}
+
+static long sqpoll_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    struct sqpoll_ctx *ctx = file->private_data;
+    u64 start;
+    long ret;
+
+    trace_u2k_ioctl_enter(cmd, arg);
+    start = u2k_lat_start();
+    switch (cmd) {
+        case SQPOLL_IOC_WAKEUP:
+            u2k_stats_inc(sqpoll_stats, SQPOLL_STAT_WAKEUP);
+            wake_up(&ctx->sq_wait);
+            ret = 0;
+            break;
+        case SQPOLL_IOC_EXEC:
+            ret = sqpoll_ioctl_exec(arg);
+            u2k_lat_end(sqpoll_lat, SQPOLL_LAT_EXEC, start);
+            break;
+        default:
+            ret = -ENOTTY;
+            break;
+    }
+    trace_u2k_ioctl_exit(cmd, ret);
+    return ret;
+}
+
+// 文件操作结构体
+static struct file_operations fops = {
+        .owner = THIS_MODULE,
+        .open = sqpoll_open,
+        .release = sqpoll_release,
+        .mmap = sqpoll_mmap,
+        .poll = sqpoll_poll,
+        .unlocked_ioctl = sqpoll_ioctl,
+};
+
+// 模块初始化
+static int __init sqpoll_driver_init(void) {
+    int ret;
+
+    // 分配设备号
+    ret = alloc_chrdev_region(&dev_num, 0, 1, DEVICE_NAME);
+    if (ret < 0) {
+        printk(KERN_ERR "Failed to allocate device number\n");
+        return ret;
+    }
+
+    // 初始化字符设备结构体并添加到系统中
+    cdev_init(&sqpoll_cdev, &fops);
+    ret = cdev_add(&sqpoll_cdev, dev_num, 1);
+    if (ret < 0) {
+        unregister_chrdev_region(dev_num, 1);
+        printk(KERN_ERR "Failed to add cdev\n");
+        return ret;
+    }
+
+    // 创建设备类
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,4,0)
+    sqpoll_class = class_create(CLASS_NAME);
+#else
+    sqpoll_class = class_create(THIS_MODULE, CLASS_NAME);
+#endif
+    if (IS_ERR(sqpoll_class)) {
+        cdev_del(&sqpoll_cdev);
+        unregister_chrdev_region(dev_num, 1);
+        printk(KERN_ERR "Failed to create class\n");
+        return PTR_ERR(sqpoll_class);
+    }
+
+    // 创建设备节点 /dev/sqpoll_demo；每次打开都会创建一个内核线程，默认只有 root 可以打开
+    sqpoll_device = device_create(sqpoll_class, NULL, dev_num, NULL, DEVICE_NAME);
+    if (IS_ERR(sqpoll_device)) {
+        class_destroy(sqpoll_class);
+        cdev_del(&sqpoll_cdev);
+        unregister_chrdev_region(dev_num, 1);
+        printk(KERN_ERR "Failed to create device\n");
+        return PTR_ERR(sqpoll_device);
+    }
+
+    // 观测失败不影响驱动本身，sqpoll_lat 为 NULL 时不记录
+    sqpoll_lat = u2k_lat_register("sqpoll", sqpoll_lat_names, SQPOLL_LAT_NR);
+    if (IS_ERR(sqpoll_lat)) {
+        printk(KERN_WARNING "Failed to register /proc/u2k/sqpoll\n");
+        sqpoll_lat = NULL;
+    }
+
+    printk(KERN_INFO "sqpoll_driver loaded successfully\n");
+    return 0;
+}
+
+// 模块卸载，此时已没有打开的文件，所有轮询线程都已停止
+static void __exit sqpoll_driver_exit(void) {
+    u64 stats[SQPOLL_STAT_NR];
+
+    u2k_stats_sum(&sqpoll_stats, stats, SQPOLL_STAT_NR);
+    printk(KERN_INFO "sqpoll_driver: %llu polled commands, %llu ioctl commands, %llu wakeups, %llu sleeps, %llu CQ full\n",
+           stats[SQPOLL_STAT_SQE], stats[SQPOLL_STAT_EXEC], stats[SQPOLL_STAT_WAKEUP],
+           stats[SQPOLL_STAT_SLEEP], stats[SQPOLL_STAT_CQ_FULL]);
+    u2k_lat_unregister(sqpoll_lat);
+    device_destroy(sqpoll_class, dev_num);
+    class_destroy(sqpoll_class);
+    cdev_del(&sqpoll_cdev);
+    unregister_chrdev_region(dev_num, 1);
+    printk(KERN_INFO "sqpoll_driver unloaded\n");
+}
+
+module_init(sqpoll_driver_init);
+module_exit(sqpoll_driver_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Ruoniao");
+MODULE_DESCRIPTION("Shared-memory submission/completion queues with a kernel polling thread");
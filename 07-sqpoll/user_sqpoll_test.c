@@ -0,0 +1,407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+
+#include "sqpoll_demo.h"
+
+/*
+ * sqpoll_demo 的功能测试与性能对比：
+ *   ./user_sqpoll_test [ops]
+ *   1. 功能测试：经共享队列执行 SET / FETCH_ADD / GET 和无效命令，检查结果与 user_data；
+ *   2. 延迟：队列深度 1，每条 FETCH_ADD 分别经 SQPOLL_IOC_EXEC 和共享队列执行，给出 p50/p99/p999；
+ *   3. 吞吐：队列深度 1~256，统计提交期间的系统调用次数（只有唤醒睡眠的轮询线程时才需要）；
+ *   4. 空闲后的首条命令：轮询线程睡眠后再提交，延迟中包含一次 ioctl 唤醒与调度；
+ *   5. CQ 满：不收割地提交超过 CQ 容量的命令，轮询线程应睡眠而不是空转，收割后唤醒它继续执行。
+ */
+
+#define DEVICE_PATH "/dev/sqpoll_demo"
+#define DEFAULT_OPS 1000000
+#define BENCH_SLOT 1
+
+struct sq_ring {
+    int fd;
+    void *area;
+    size_t size;
+    struct sqpoll_ctrl *ctrl;
+    struct sqpoll_sqe *sqes;
+    struct sqpoll_cqe *cqes;
+    uint32_t sq_mask, cq_mask;
+    uint32_t sq_tail;     // 本地的提交位置
+    uint32_t cq_head;     // 本地的收割位置
+    uint64_t wakeups;     // 为唤醒轮询线程发起的 ioctl 次数
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// 先映射控制页获取区域大小，再映射整个区域
+static int ring_open(struct sq_ring *r) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    struct sqpoll_ctrl *ctrl;
+
+    memset(r, 0, sizeof(*r));
+    r->fd = open(DEVICE_PATH, O_RDWR);
+    if (r->fd < 0) {
+        perror("open " DEVICE_PATH);
+        return -1;
+    }
+    ctrl = mmap(NULL, page_size, PROT_READ, MAP_SHARED, r->fd, 0);
+    if (ctrl == MAP_FAILED) {
+        perror("mmap ctrl");
+        close(r->fd);
+        return -1;
+    }
+    r->size = ctrl->ring_size;
+    munmap(ctrl, page_size);
+
+    r->area = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, 0);
+    if (r->area == MAP_FAILED) {
+        perror("mmap ring");
+        close(r->fd);
+        return -1;
+    }
+    r->ctrl = r->area;
+    r->sqes = (struct sqpoll_sqe *)((char *)r->area + r->ctrl->sq_offset);
+    r->cqes = (struct sqpoll_cqe *)((char *)r->area + r->ctrl->cq_offset);
+    r->sq_mask = r->ctrl->sq_entries - 1;
+    r->cq_mask = r->ctrl->cq_entries - 1;
+    r->sq_tail = r->ctrl->sq_tail;
+    r->cq_head = r->ctrl->cq_head;
+    return 0;
+}
+
+static void ring_close(struct sq_ring *r) {
+    munmap(r->area, r->size);
+    close(r->fd);
+}
+
+// 在本地位置填写一条 SQE，ring_submit 之前内核看不到它
+static void ring_prep(struct sq_ring *r, uint8_t opcode, uint32_t slot, uint64_t arg, uint64_t user_data) {
+    struct sqpoll_sqe *sqe = &r->sqes[r->sq_tail & r->sq_mask];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->slot = slot;
+    sqe->arg = arg;
+    sqe->user_data = user_data;
+    r->sq_tail++;
+}
+
+/*
+ * 发布已填写的 SQE。release：SQE 的内容先于 sq_tail 对内核可见；
+ * 之后的全屏障与内核“置 NEED_WAKEUP -> 全屏障 -> 读 sq_tail”配对，保证唤醒不会丢失。
+ */
+static void ring_submit(struct sq_ring *r) {
+    __atomic_store_n(&r->ctrl->sq_tail, r->sq_tail, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->ctrl->flags, __ATOMIC_RELAXED) & SQPOLL_NEED_WAKEUP) {
+        ioctl(r->fd, SQPOLL_IOC_WAKEUP);
+        r->wakeups++;
+    }
+}
+
+// 取一条 CQE，没有时返回 NULL；用完后调用 ring_cqe_seen
+static struct sqpoll_cqe *ring_peek(struct sq_ring *r) {
+    // acquire：看到 cq_tail 后，对应 CQE 的内容一定已经写完
+    if (__atomic_load_n(&r->ctrl->cq_tail, __ATOMIC_ACQUIRE) == r->cq_head) {
+        return NULL;
+    }
+    return &r->cqes[r->cq_head & r->cq_mask];
+}
+
+static void ring_cqe_seen(struct sq_ring *r) {
+    __atomic_store_n(&r->ctrl->cq_head, ++r->cq_head, __ATOMIC_RELEASE);
+}
+
+/*
+ * 收割一批 CQE 之后调用：轮询线程可能因 CQ 满而睡眠，与 ring_submit 相同，
+ * 全屏障保证 cq_head 先于读 flags 可见。未完成的命令不超过 CQ 容量时可以省略。
+ */
+static void ring_cq_flush(struct sq_ring *r) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&r->ctrl->flags, __ATOMIC_RELAXED) & SQPOLL_NEED_WAKEUP) {
+        ioctl(r->fd, SQPOLL_IOC_WAKEUP);
+        r->wakeups++;
+    }
+}
+
+// 忙等一条 CQE；长时间等不到时让出 CPU，单核虚拟机上轮询线程需要本进程让出 CPU 才能运行
+static struct sqpoll_cqe *ring_wait(struct sq_ring *r) {
+    struct sqpoll_cqe *cqe;
+    unsigned int spins = 0;
+
+    while (!(cqe = ring_peek(r))) {
+        if (++spins % 4096 == 0) {
+            sched_yield();
+        }
+    }
+    return cqe;
+}
+
+static int ioctl_exec(int fd, uint8_t opcode, uint32_t slot, uint64_t arg, struct sqpoll_cqe *out) {
+    struct sqpoll_exec ex;
+
+    memset(&ex, 0, sizeof(ex));
+    ex.sqe.opcode = opcode;
+    ex.sqe.slot = slot;
+    ex.sqe.arg = arg;
+    if (ioctl(fd, SQPOLL_IOC_EXEC, &ex) < 0) {
+        return -1;
+    }
+    *out = ex.cqe;
+    return 0;
+}
+
+static int func_test(struct sq_ring *r) {
+    static const struct {
+        uint8_t opcode;
+        uint32_t slot;
+        uint64_t arg;
+        int32_t status;
+        uint64_t result;
+    } cases[] = {
+        { SQPOLL_OP_SET, 0, 100, 0, 0 },
+        { SQPOLL_OP_FETCH_ADD, 0, 5, 0, 100 },
+        { SQPOLL_OP_GET, 0, 0, 0, 105 },
+        { SQPOLL_OP_NOP, 0, 0, 0, 0 },
+        { SQPOLL_OP_GET, SQPOLL_NR_SLOTS, 0, -EINVAL, 0 },
+        { SQPOLL_OP_NR, 0, 0, -EINVAL, 0 },
+    };
+    const int n = sizeof(cases) / sizeof(cases[0]);
+    struct sqpoll_cqe cqe = { 0 };
+
+    // 一次提交全部命令，内核按顺序执行
+    for (int i = 0; i < n; i++) {
+        ring_prep(r, cases[i].opcode, cases[i].slot, cases[i].arg, 1000 + i);
+    }
+    ring_submit(r);
+    for (int i = 0; i < n; i++) {
+        struct sqpoll_cqe *c = ring_wait(r);
+
+        if (c->user_data != (uint64_t)(1000 + i) || c->status != cases[i].status || c->result != cases[i].result) {
+            fprintf(stderr, "cqe %d: user_data %llu status %d result %llu, expected status %d result %llu\n", i,
+                    (unsigned long long)c->user_data, c->status, (unsigned long long)c->result, cases[i].status,
+                    (unsigned long long)cases[i].result);
+            return -1;
+        }
+        ring_cqe_seen(r);
+    }
+
+    // 保留字段非 0 的 SQE 被拒绝
+    ring_prep(r, SQPOLL_OP_NOP, 0, 0, 2000);
+    r->sqes[(r->sq_tail - 1) & r->sq_mask].pad[1] = 1;
+    ring_submit(r);
+    if (ring_wait(r)->status != -EINVAL) {
+        fprintf(stderr, "SQE with nonzero pad was accepted\n");
+        return -1;
+    }
+    ring_cqe_seen(r);
+
+    // 两条路径操作的是同一组槽位
+    if (ioctl_exec(r->fd, SQPOLL_OP_GET, 0, 0, &cqe) < 0 || cqe.status || cqe.result != 105) {
+        fprintf(stderr, "ioctl GET: status %d result %llu\n", cqe.status, (unsigned long long)cqe.result);
+        return -1;
+    }
+
+    printf("functional test passed: %d commands, SQ %u / CQ %u entries\n", n, r->ctrl->sq_entries,
+           r->ctrl->cq_entries);
+    return 0;
+}
+
+static void print_lat(const char *name, uint64_t *lat, int ops) {
+    qsort(lat, ops, sizeof(*lat), cmp_u64);
+    printf("%-8s p50 %7.2f  p99 %7.2f  p999 %7.2f us\n", name, lat[ops / 2] / 1e3, lat[ops * 99 / 100] / 1e3,
+           lat[ops * 999 / 1000] / 1e3);
+}
+
+// 队列深度 1 下每条命令的往返延迟
+static void bench_latency(struct sq_ring *r, int ops) {
+    uint64_t *lat = malloc(ops * sizeof(*lat));
+    struct sqpoll_cqe cqe;
+
+    if (!lat) {
+        return;
+    }
+    for (int i = 0; i < ops; i++) {
+        uint64_t t = now_ns();
+
+        ioctl_exec(r->fd, SQPOLL_OP_FETCH_ADD, BENCH_SLOT, 1, &cqe);
+        lat[i] = now_ns() - t;
+    }
+    print_lat("ioctl", lat, ops);
+
+    for (int i = 0; i < ops; i++) {
+        uint64_t t = now_ns();
+
+        ring_prep(r, SQPOLL_OP_FETCH_ADD, BENCH_SLOT, 1, i);
+        ring_submit(r);
+        ring_wait(r);
+        ring_cqe_seen(r);
+        lat[i] = now_ns() - t;
+    }
+    print_lat("sqpoll", lat, ops);
+    free(lat);
+}
+
+// 始终保持 depth 条未完成的命令，返回每秒完成的命令数
+static double bench_depth(struct sq_ring *r, int ops, unsigned int depth) {
+    int submitted = 0, completed = 0;
+    uint64_t start = now_ns();
+
+    while (completed < ops) {
+        struct sqpoll_cqe *cqe;
+        int n = 0;
+
+        while (submitted < ops && submitted - completed < (int)depth) {
+            ring_prep(r, SQPOLL_OP_FETCH_ADD, BENCH_SLOT, 1, submitted++);
+            n++;
+        }
+        if (n) {
+            ring_submit(r);
+        }
+        // 未完成的命令已达到 depth 条（或已全部提交），至少等到一条完成再补充
+        cqe = ring_wait(r);
+        do {
+            ring_cqe_seen(r);
+            completed++;
+        } while ((cqe = ring_peek(r)));
+    }
+    return ops / ((now_ns() - start) / 1e9);
+}
+
+static void bench_throughput(struct sq_ring *r, int ops) {
+    struct sqpoll_cqe cqe;
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < ops; i++) {
+        ioctl_exec(r->fd, SQPOLL_OP_FETCH_ADD, BENCH_SLOT, 1, &cqe);
+    }
+    printf("ioctl          %12.0f ops/s  %d syscalls\n", ops / ((now_ns() - start) / 1e9), ops);
+
+    for (unsigned int depth = 1; depth <= r->ctrl->sq_entries && depth <= 256; depth *= 4) {
+        uint64_t wakeups = r->wakeups;
+        double rate = bench_depth(r, ops, depth);
+
+        printf("sqpoll depth %-3u %10.0f ops/s  %llu syscalls\n", depth, rate,
+               (unsigned long long)(r->wakeups - wakeups));
+    }
+}
+
+// 每次先等轮询线程睡眠，再提交一条命令
+static void bench_idle(struct sq_ring *r) {
+    const int rounds = 20;
+    uint64_t lat[rounds];
+    uint64_t wakeups = r->wakeups;
+
+    for (int i = 0; i < rounds; i++) {
+        uint64_t t;
+
+        while (!(__atomic_load_n(&r->ctrl->flags, __ATOMIC_RELAXED) & SQPOLL_NEED_WAKEUP)) {
+            usleep(1000);
+        }
+        t = now_ns();
+        ring_prep(r, SQPOLL_OP_NOP, 0, 0, i);
+        ring_submit(r);
+        ring_wait(r);
+        ring_cqe_seen(r);
+        lat[i] = now_ns() - t;
+    }
+    qsort(lat, rounds, sizeof(*lat), cmp_u64);
+    printf("after idle: p50 %.2f us, max %.2f us (%llu wakeups, poller slept %llu times)\n", lat[rounds / 2] / 1e3,
+           lat[rounds - 1] / 1e3, (unsigned long long)(r->wakeups - wakeups), (unsigned long long)r->ctrl->sleeps);
+}
+
+/*
+ * 不收割地提交 CQ 容量加一批的命令：最后一批留在 SQ 中，轮询线程应在 sq_idle_us 后睡眠
+ * （sleeps 增加，cq_full 只计一次），收割并 ring_cq_flush 之后继续执行剩下的命令。
+ */
+static int cq_full_test(struct sq_ring *r) {
+    uint32_t batch = r->ctrl->sq_entries, total = r->ctrl->cq_entries + batch;
+    uint64_t sleeps, cq_full, deadline;
+    uint32_t seq = 0;
+
+    for (int b = 0; b < 3; b++) {
+        for (uint32_t i = 0; i < batch; i++) {
+            ring_prep(r, SQPOLL_OP_NOP, 0, 0, seq++);
+        }
+        if (b == 2) {
+            sleeps = __atomic_load_n(&r->ctrl->sleeps, __ATOMIC_RELAXED);
+            cq_full = __atomic_load_n(&r->ctrl->cq_full, __ATOMIC_RELAXED);
+        }
+        ring_submit(r);
+        // 前两批会被全部取走，各自占满 CQ 的一半
+        while (b < 2 && __atomic_load_n(&r->ctrl->sq_head, __ATOMIC_ACQUIRE) != r->sq_tail) {
+            sched_yield();
+        }
+    }
+
+    deadline = now_ns() + 1000000000ULL;
+    while (__atomic_load_n(&r->ctrl->sleeps, __ATOMIC_RELAXED) == sleeps && now_ns() < deadline) {
+        usleep(1000);
+    }
+    if (__atomic_load_n(&r->ctrl->sleeps, __ATOMIC_RELAXED) == sleeps) {
+        fprintf(stderr, "cq full: poller did not sleep within 1 s\n");
+        return -1;
+    }
+    cq_full = __atomic_load_n(&r->ctrl->cq_full, __ATOMIC_RELAXED) - cq_full;
+
+    for (uint32_t i = 0; i < total; i++) {
+        struct sqpoll_cqe *c = ring_wait(r);
+
+        if (c->user_data != i || c->status) {
+            fprintf(stderr, "cq full: cqe %u has user_data %llu status %d\n", i, (unsigned long long)c->user_data,
+                    c->status);
+            return -1;
+        }
+        ring_cqe_seen(r);
+        // 每收割一半 CQ 唤醒一次，剩下的一批才能被取走
+        if ((i + 1) % batch == 0) {
+            ring_cq_flush(r);
+        }
+    }
+    printf("cq full: poller slept with %u SQEs pending, cq_full +%llu, all %u completed after reaping\n", batch,
+           (unsigned long long)cq_full, total);
+    return cq_full == 1 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    int ops = argc > 1 ? atoi(argv[1]) : DEFAULT_OPS;
+    struct sq_ring r;
+
+    if (ops < 1000) {
+        ops = 1000;
+    }
+    if (ring_open(&r) < 0) {
+        return EXIT_FAILURE;
+    }
+    if (func_test(&r) < 0 || cq_full_test(&r) < 0) {
+        ring_close(&r);
+        return EXIT_FAILURE;
+    }
+
+    printf("\nlatency, depth 1, %d FETCH_ADD each:\n", ops / 10);
+    bench_latency(&r, ops / 10);
+    printf("\nthroughput, %d FETCH_ADD each:\n", ops);
+    bench_throughput(&r, ops);
+    printf("\n");
+    bench_idle(&r);
+
+    ring_close(&r);
+    return EXIT_SUCCESS;
+}
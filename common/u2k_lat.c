@@ -0,0 +1,164 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/version.h>
+
+#include "u2k_lat.h"
+
+/*
+ * u2k_common.ko：各个驱动共用的观测组件。
+ * 本文件提供延迟直方图及其 /proc/u2k/<name> 接口，各驱动通过导出的符号注册自己的直方图。
+ */
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,17,0)
+#define pde_data(inode) PDE_DATA(inode)
+#endif
+
+static struct proc_dir_entry *u2k_dir;  // /proc/u2k
+
+// 把所有 CPU 上某种操作的计数汇总到 out[0..U2K_LAT_SLOTS)
+static void u2k_lat_sum(struct u2k_lat *lat, int op, u64 *out) {
+    int cpu, i;
+
+    memset(out, 0, U2K_LAT_SLOTS * sizeof(*out));
+    for_each_possible_cpu(cpu) {
+        const u64 *slots = per_cpu_ptr(lat->slots, cpu) + op * U2K_LAT_SLOTS;
+
+        for (i = 0; i < U2K_LAT_SLOTS; i++) {
+            out[i] += READ_ONCE(slots[i]);
+        }
+    }
+}
+
+// 返回累计计数首次达到 total * permille / 1000 的桶的上界（ns，不含）
+static u64 u2k_lat_percentile(const u64 *buckets, u64 total, unsigned int permille) {
+    u64 target = div_u64(total * permille + 999, 1000), cum = 0;
+    int b;
+
+    for (b = 0; b < U2K_LAT_BUCKETS; b++) {
+        cum += buckets[b];
+        if (cum >= target) {
+            break;
+        }
+    }
+    return 1ULL << min(b, U2K_LAT_BUCKETS - 1);
+}
+
+static int u2k_lat_show(struct seq_file *m, void *v) {
+    struct u2k_lat *lat = m->private;
+    u64 sum[U2K_LAT_SLOTS];
+    int op, b;
+
+    seq_printf(m, "%-12s %12s %10s %10s %10s %10s\n", "op", "count", "avg_ns", "p50_ns", "p99_ns", "p999_ns");
+    for (op = 0; op < lat->nr_ops; op++) {
+        u64 total = 0;
+
+        u2k_lat_sum(lat, op, sum);
+        for (b = 0; b < U2K_LAT_BUCKETS; b++) {
+            total += sum[b];
+        }
+        if (!total) {
+            seq_printf(m, "%-12s %12d %10d %10d %10d %10d\n", lat->op_names[op], 0, 0, 0, 0, 0);
+            continue;
+        }
+        seq_printf(m, "%-12s %12llu %10llu %10llu %10llu %10llu\n", lat->op_names[op], total,
+                   div64_u64(sum[U2K_LAT_BUCKETS], total), u2k_lat_percentile(sum, total, 500),
+                   u2k_lat_percentile(sum, total, 990), u2k_lat_percentile(sum, total, 999));
+    }
+
+    // 非空的桶：<操作> <桶上界 ns（不含）> <次数>，便于脚本画直方图
+    seq_puts(m, "\nbuckets:\n");
+    for (op = 0; op < lat->nr_ops; op++) {
+        u2k_lat_sum(lat, op, sum);
+        for (b = 0; b < U2K_LAT_BUCKETS; b++) {
+            if (sum[b]) {
+                seq_printf(m, "%-12s <%-20llu %llu\n", lat->op_names[op], 1ULL << b, sum[b]);
+            }
+        }
+    }
+    return 0;
+}
+
+static int u2k_lat_open(struct inode *inode, struct file *file) {
+    return single_open(file, u2k_lat_show, pde_data(inode));
+}
+
+// 任意写入都会清零所有 CPU 上的计数（文件为 0644，只有 root 可以清零），与并发的记录之间不保证原子性
+static ssize_t u2k_lat_write(struct file *file, const char __user *buf, size_t count, loff_t *pos) {
+    struct u2k_lat *lat = ((struct seq_file *)file->private_data)->private;
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        memset(per_cpu_ptr(lat->slots, cpu), 0, lat->nr_ops * U2K_LAT_SLOTS * sizeof(u64));
+    }
+    return count;
+}
+
+static const struct proc_ops u2k_lat_fops = {
+    .proc_open = u2k_lat_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+    .proc_write = u2k_lat_write,
+};
+
+struct u2k_lat *u2k_lat_register(const char *name, const char *const *op_names, int nr_ops) {
+    struct u2k_lat *lat;
+
+    lat = kzalloc(sizeof(*lat), GFP_KERNEL);
+    if (!lat) {
+        return ERR_PTR(-ENOMEM);
+    }
+    lat->name = name;
+    lat->op_names = op_names;
+    lat->nr_ops = nr_ops;
+    lat->slots = __alloc_percpu(nr_ops * U2K_LAT_SLOTS * sizeof(u64), sizeof(u64));
+    if (!lat->slots) {
+        kfree(lat);
+        return ERR_PTR(-ENOMEM);
+    }
+
+    lat->pde = proc_create_data(name, 0644, u2k_dir, &u2k_lat_fops, lat);
+    if (!lat->pde) {
+        free_percpu(lat->slots);
+        kfree(lat);
+        return ERR_PTR(-ENOMEM);
+    }
+    return lat;
+}
+EXPORT_SYMBOL_GPL(u2k_lat_register);
+
+void u2k_lat_unregister(struct u2k_lat *lat) {
+    if (IS_ERR_OR_NULL(lat)) {
+        return;
+    }
+    proc_remove(lat->pde);  // 等待正在进行的读写结束
+    free_percpu(lat->slots);
+    kfree(lat);
+}
+EXPORT_SYMBOL_GPL(u2k_lat_unregister);
+
+static int __init u2k_common_init(void) {
+    u2k_dir = proc_mkdir("u2k", NULL);
+    if (!u2k_dir) {
+        printk(KERN_ERR "Failed to create /proc/u2k\n");
+        return -ENOMEM;
+    }
+    printk(KERN_INFO "u2k_common loaded\n");
+    return 0;
+}
+
+static void __exit u2k_common_exit(void) {
+    proc_remove(u2k_dir);
+    printk(KERN_INFO "u2k_common unloaded\n");
+}
+
+module_init(u2k_common_init);
+module_exit(u2k_common_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Ruoniao");
+MODULE_DESCRIPTION("Shared instrumentation for the user-to-kernel demos");
@@ -0,0 +1,68 @@
+#ifndef U2K_LAT_H
+#define U2K_LAT_H
+
+/*
+ * 各个驱动共用的延迟直方图，实现位于 u2k_common.ko（common/u2k_lat.c）。
+ *
+ * 每个传输方式注册一个直方图，对应 /proc/u2k/<name>，其中每种操作一行，
+ * 给出次数、平均值以及 p50/p99/p999。桶按 log2(ns) 划分，第 b 个桶统计 [2^(b-1), 2^b) ns，
+ * 因此百分位给出的是所在桶的上界。写该文件（如 echo 0 >）清零所有计数。
+ *
+ * 记录路径只修改本 CPU 的计数（this_cpu_inc / this_cpu_add），不加锁也没有共享 cache line：
+ *   u64 t = u2k_lat_start();
+ *   ...
+ *   u2k_lat_end(my_lat, MY_LAT_READ, t);
+ *
+ * 使用者的 Makefile 需要把 common/Module.symvers 加入 KBUILD_EXTRA_SYMBOLS，
+ * 并在加载驱动之前先加载 u2k_common.ko。
+ */
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/bitops.h>
+#include <linux/percpu.h>
+
+#define U2K_LAT_BUCKETS 64                  // log2 桶数，覆盖整个 u64 纳秒范围
+#define U2K_LAT_SLOTS (U2K_LAT_BUCKETS + 1) // 每种操作的计数槽：各个桶 + 纳秒总和
+
+struct proc_dir_entry;
+
+struct u2k_lat {
+    const char *name;               // /proc/u2k 下的文件名
+    const char *const *op_names;    // 每种操作的名字
+    int nr_ops;
+    u64 __percpu *slots;            // nr_ops * U2K_LAT_SLOTS 个计数
+    struct proc_dir_entry *pde;
+};
+
+/**
+ * @brief 注册一个直方图并创建 /proc/u2k/<name>
+ *
+ * @param name 文件名，如 "ioctl"
+ * @param op_names 操作名数组，需在直方图的整个生命周期内有效
+ * @param nr_ops 操作数
+ * @return struct u2k_lat* 成功返回直方图，失败返回 ERR_PTR
+ */
+struct u2k_lat *u2k_lat_register(const char *name, const char *const *op_names, int nr_ops);
+
+// 删除 /proc 文件并释放直方图，允许传入 NULL 或 ERR_PTR
+void u2k_lat_unregister(struct u2k_lat *lat);
+
+static inline u64 u2k_lat_start(void) {
+    return ktime_get_ns();
+}
+
+// 记录一次操作从 start 到现在的耗时；lat 为 NULL 时什么也不做
+static inline void u2k_lat_end(struct u2k_lat *lat, int op, u64 start) {
+    u64 ns = ktime_get_ns() - start;
+    u64 __percpu *slots;
+
+    if (!lat) {
+        return;
+    }
+    slots = lat->slots + op * U2K_LAT_SLOTS;
+    this_cpu_inc(slots[min_t(int, fls64(ns), U2K_LAT_BUCKETS - 1)]);
+    this_cpu_add(slots[U2K_LAT_BUCKETS], ns);
+}
+
+#endif // U2K_LAT_H
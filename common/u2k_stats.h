@@ -0,0 +1,45 @@
+#ifndef U2K_STATS_H
+#define U2K_STATS_H
+
+/*
+ * 各个驱动共用的 per-CPU 统计计数器。
+ *
+ * 热路径上每个 CPU 只修改自己的副本（this_cpu_add 是一条不带 lock 前缀的指令，
+ * 且不需要关抢占），多核并发时不会像共享的原子计数器那样在 CPU 之间来回迁移 cache line。
+ * 读取时再把所有 CPU 的副本加起来，读到的是一个近似的瞬时值。
+ *
+ * 用法：
+ *   enum { MY_STAT_READ, MY_STAT_WRITE, MY_STAT_NR };
+ *   static DEFINE_PER_CPU(struct u2k_stats, my_stats);
+ *   u2k_stats_inc(my_stats, MY_STAT_READ);
+ *   u2k_stats_sum(&my_stats, out, MY_STAT_NR);
+ */
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+#define U2K_STATS_MAX 16  // 每个驱动最多的计数器个数
+
+struct u2k_stats {
+    u64 cnt[U2K_STATS_MAX];
+};
+
+#define u2k_stats_inc(pcp, idx)    this_cpu_inc((pcp).cnt[idx])
+#define u2k_stats_add(pcp, idx, n) this_cpu_add((pcp).cnt[idx], (n))
+
+// 把所有 CPU 上的前 nr 个计数器分别求和到 out[0..nr)
+static inline void u2k_stats_sum(struct u2k_stats __percpu *stats, u64 *out, int nr) {
+    int cpu, i;
+
+    memset(out, 0, nr * sizeof(*out));
+    for_each_possible_cpu(cpu) {
+        const struct u2k_stats *s = per_cpu_ptr(stats, cpu);
+
+        for (i = 0; i < nr; i++) {
+            out[i] += READ_ONCE(s->cnt[i]);
+        }
+    }
+}
+
+#endif // U2K_STATS_H
@@ -0,0 +1,19 @@
+#include <linux/module.h>
+
+/*
+ * 跟踪点的定义只能在一个编译单元中生成，放在 u2k_common.ko 中并导出，
+ * 各个驱动只包含 u2k_trace.h 并调用 trace_u2k_*()。
+ */
+#define CREATE_TRACE_POINTS
+#include "u2k_trace.h"
+
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_ioctl_enter);
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_ioctl_exit);
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_rw_enter);
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_rw_exit);
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_proc_enter);
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_proc_exit);
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_mmap_enter);
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_mmap_exit);
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_netlink_enter);
+EXPORT_TRACEPOINT_SYMBOL_GPL(u2k_netlink_exit);
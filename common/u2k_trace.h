@@ -0,0 +1,180 @@
+/*
+ * 各个驱动热路径上的静态跟踪点，定义（CREATE_TRACE_POINTS）位于 u2k_common.ko（common/u2k_trace.c）。
+ *
+ * 跟踪点未启用时只是一条被 static key 跳过的 nop，可以常驻在生产环境中。启用方式：
+ *   perf trace -e 'u2k:*' ./user_ioctl_test
+ *   trace-cmd record -e u2k ./user_rw_test
+ *   echo 1 > /sys/kernel/tracing/events/u2k/enable
+ * 每个传输方式都有一对 enter/exit 事件，exit 携带返回值，二者的时间差即内核内耗时。
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM u2k
+
+#if !defined(U2K_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define U2K_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/ioctl.h>  // _IOC_NR
+
+// ioctl：命令号与参数
+TRACE_EVENT(u2k_ioctl_enter,
+    TP_PROTO(unsigned int cmd, unsigned long arg),
+    TP_ARGS(cmd, arg),
+    TP_STRUCT__entry(
+        __field(unsigned int, cmd)
+        __field(unsigned long, arg)
+    ),
+    TP_fast_assign(
+        __entry->cmd = cmd;
+        __entry->arg = arg;
+    ),
+    TP_printk("cmd=0x%x nr=%u arg=0x%lx", __entry->cmd, _IOC_NR(__entry->cmd), __entry->arg)
+);
+
+TRACE_EVENT(u2k_ioctl_exit,
+    TP_PROTO(unsigned int cmd, long ret),
+    TP_ARGS(cmd, ret),
+    TP_STRUCT__entry(
+        __field(unsigned int, cmd)
+        __field(long, ret)
+    ),
+    TP_fast_assign(
+        __entry->cmd = cmd;
+        __entry->ret = ret;
+    ),
+    TP_printk("cmd=0x%x nr=%u ret=%ld", __entry->cmd, _IOC_NR(__entry->cmd), __entry->ret)
+);
+
+// read/write：次设备号、方向、请求大小与偏移
+TRACE_EVENT(u2k_rw_enter,
+    TP_PROTO(unsigned int minor, bool write, size_t count, loff_t pos),
+    TP_ARGS(minor, write, count, pos),
+    TP_STRUCT__entry(
+        __field(unsigned int, minor)
+        __field(bool, write)
+        __field(size_t, count)
+        __field(loff_t, pos)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->write = write;
+        __entry->count = count;
+        __entry->pos = pos;
+    ),
+    TP_printk("minor=%u %s count=%zu pos=%lld", __entry->minor, __entry->write ? "write" : "read",
+              __entry->count, __entry->pos)
+);
+
+TRACE_EVENT(u2k_rw_exit,
+    TP_PROTO(unsigned int minor, bool write, ssize_t ret),
+    TP_ARGS(minor, write, ret),
+    TP_STRUCT__entry(
+        __field(unsigned int, minor)
+        __field(bool, write)
+        __field(ssize_t, ret)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->write = write;
+        __entry->ret = ret;
+    ),
+    TP_printk("minor=%u %s ret=%zd", __entry->minor, __entry->write ? "write" : "read", __entry->ret)
+);
+
+// procfs：方向、请求大小与偏移
+TRACE_EVENT(u2k_proc_enter,
+    TP_PROTO(bool write, size_t count, loff_t pos),
+    TP_ARGS(write, count, pos),
+    TP_STRUCT__entry(
+        __field(bool, write)
+        __field(size_t, count)
+        __field(loff_t, pos)
+    ),
+    TP_fast_assign(
+        __entry->write = write;
+        __entry->count = count;
+        __entry->pos = pos;
+    ),
+    TP_printk("%s count=%zu pos=%lld", __entry->write ? "write" : "read", __entry->count, __entry->pos)
+);
+
+TRACE_EVENT(u2k_proc_exit,
+    TP_PROTO(bool write, ssize_t ret),
+    TP_ARGS(write, ret),
+    TP_STRUCT__entry(
+        __field(bool, write)
+        __field(ssize_t, ret)
+    ),
+    TP_fast_assign(
+        __entry->write = write;
+        __entry->ret = ret;
+    ),
+    TP_printk("%s ret=%zd", __entry->write ? "write" : "read", __entry->ret)
+);
+
+// mmap：映射偏移（页）与长度
+TRACE_EVENT(u2k_mmap_enter,
+    TP_PROTO(unsigned long pgoff, unsigned long size),
+    TP_ARGS(pgoff, size),
+    TP_STRUCT__entry(
+        __field(unsigned long, pgoff)
+        __field(unsigned long, size)
+    ),
+    TP_fast_assign(
+        __entry->pgoff = pgoff;
+        __entry->size = size;
+    ),
+    TP_printk("pgoff=0x%lx size=%lu", __entry->pgoff, __entry->size)
+);
+
+TRACE_EVENT(u2k_mmap_exit,
+    TP_PROTO(unsigned long pgoff, int ret),
+    TP_ARGS(pgoff, ret),
+    TP_STRUCT__entry(
+        __field(unsigned long, pgoff)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->pgoff = pgoff;
+        __entry->ret = ret;
+    ),
+    TP_printk("pgoff=0x%lx ret=%d", __entry->pgoff, __entry->ret)
+);
+
+// netlink：发送者 portid 与消息长度（含 nlmsghdr）
+TRACE_EVENT(u2k_netlink_enter,
+    TP_PROTO(u32 portid, unsigned int len),
+    TP_ARGS(portid, len),
+    TP_STRUCT__entry(
+        __field(u32, portid)
+        __field(unsigned int, len)
+    ),
+    TP_fast_assign(
+        __entry->portid = portid;
+        __entry->len = len;
+    ),
+    TP_printk("portid=%u len=%u", __entry->portid, __entry->len)
+);
+
+TRACE_EVENT(u2k_netlink_exit,
+    TP_PROTO(u32 portid, int ret),
+    TP_ARGS(portid, ret),
+    TP_STRUCT__entry(
+        __field(u32, portid)
+        __field(int, ret)
+    ),
+    TP_fast_assign(
+        __entry->portid = portid;
+        __entry->ret = ret;
+    ),
+    TP_printk("portid=%u ret=%d", __entry->portid, __entry->ret)
+);
+
+#endif // U2K_TRACE_H
+
+// define_trace.h 需要按路径重新包含本文件，common/Makefile 把本目录加入了头文件搜索路径
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE u2k_trace
+#include <trace/define_trace.h>